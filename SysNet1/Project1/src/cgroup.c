@@ -0,0 +1,282 @@
+/**
+ * File: cgroup.c
+ *
+ * Implements cgroup.h. See cgroup.h for details.
+ *
+ * @author Adam Mooers
+ * @author Luke Kledzik
+ * @date 9/18/2016
+ * @info Course COP4634
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/sched.h>
+#include "cgroup.h"
+
+/*
+ * Size of the buffers holding a path below the group or the contents of a
+ * cgroup interface file
+ */
+#define CGROUP_PATH_BYTES 4096
+#define CGROUP_FILE_BYTES 512
+
+/*
+ * Permissions given to a new group directory (before the umask)
+ */
+#define CGROUP_DIR_MODE 0755
+
+/**
+ * Writes a value to an interface file of a group.
+ *
+ * @param dir the group directory
+ * @param file the interface file, e.g. memory.max
+ * @param value the value to write
+ * @return 1 if successful, 0 otherwise
+ */
+static int writeCgroupFile(const char* dir, const char* file, const char* value) {
+    char path[CGROUP_PATH_BYTES];
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    fd = open(path, O_WRONLY | O_CLOEXEC);
+
+    if (fd == -1) {
+        return 0;
+    }
+
+    // The kernel parses the whole value from a single write
+    ssize_t len = strlen(value);
+    int written = write(fd, value, len) == len;
+    int writeErrno = errno;
+
+    close(fd);
+    errno = writeErrno;
+
+    return written;
+}
+
+/**
+ * Applies one limit of a group and prints an error if it is refused.
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int applyLimit(const char* dir, const char* file, const char* value) {
+    if (!writeCgroupFile(dir, file, value)) {
+        printf("Setting %s of %s to %s has failed.\n", file, dir, value);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Enables a controller for the groups below a parent and prints an error if
+ * it is refused. Enabling a controller that is already enabled succeeds.
+ *
+ * @param parent the parent directory
+ * @param controller the controller, e.g. memory
+ * @return 1 if successful, 0 otherwise
+ */
+static int enableController(const char* parent, const char* controller) {
+    char value[CGROUP_FILE_BYTES];
+
+    snprintf(value, sizeof(value), "+%s", controller);
+
+    if (!writeCgroupFile(parent, "cgroup.subtree_control", value)) {
+        printf("Enabling the %s controller in %s has failed: %s\n",
+            controller, parent, strerror(errno));
+        return 0;
+    }
+
+    return 1;
+}
+
+int createCgroup(const CgroupLimits_t* limits, Cgroup_t* group) {
+    static int groupCount = 0;
+    char name[CGROUP_PATH_BYTES];
+    char cpuMax[64];
+    int applied = 1;
+
+    group->path = NULL;
+    group->procsFd = -1;
+    group->dirFd = -1;
+
+    // Without its controller a limit has no interface file to write
+    if ((limits->cpuLimit > 0 && !enableController(limits->parent, "cpu")) ||
+        (limits->memoryMax != NULL && !enableController(limits->parent, "memory")) ||
+        (limits->cpus != NULL && !enableController(limits->parent, "cpuset"))) {
+        return 0;
+    }
+
+    // One group per command, named after the shell so leftovers can be traced
+    snprintf(name, sizeof(name), "%s/myshell-%d-%d", limits->parent, (int)getpid(), groupCount++);
+
+    if (mkdir(name, CGROUP_DIR_MODE) == -1) {
+        printf("Creating the cgroup %s has failed.\n", name);
+        return 0;
+    }
+
+    group->path = strdup(name);
+
+    if (group->path == NULL) {
+        rmdir(name);
+        return 0;
+    }
+
+    if (limits->cpuLimit > 0) {
+        snprintf(cpuMax, sizeof(cpuMax), "%ld %d",
+            (long)(limits->cpuLimit * CPU_MAX_PERIOD_US), CPU_MAX_PERIOD_US);
+        applied = applyLimit(group->path, "cpu.max", cpuMax);
+    }
+
+    if (applied && limits->memoryMax != NULL) {
+        applied = applyLimit(group->path, "memory.max", limits->memoryMax);
+    }
+
+    if (applied && limits->cpus != NULL) {
+        applied = applyLimit(group->path, "cpuset.cpus", limits->cpus);
+    }
+
+    if (applied) {
+        snprintf(name, sizeof(name), "%s/cgroup.procs", group->path);
+        group->procsFd = open(name, O_WRONLY | O_CLOEXEC);
+
+        if (group->procsFd == -1) {
+            printf("Opening %s has failed.\n", name);
+            applied = 0;
+        }
+    }
+
+    if (applied) {
+        group->dirFd = open(group->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        if (group->dirFd == -1) {
+            printf("Opening %s has failed.\n", group->path);
+            applied = 0;
+        }
+    }
+
+    if (!applied) {
+        removeCgroup(group);
+        return 0;
+    }
+
+    return 1;
+}
+
+pid_t forkIntoCgroup(const Cgroup_t* group) {
+#if defined(SYS_clone3) && defined(CLONE_INTO_CGROUP)
+    struct clone_args args;
+
+    memset(&args, 0, sizeof(args));
+    args.flags = CLONE_INTO_CGROUP;
+    args.exit_signal = SIGCHLD;
+    args.cgroup = (unsigned long)group->dirFd;
+
+    // Without CLONE_VM the child gets a copy of the parent, as with fork()
+    return (pid_t)syscall(SYS_clone3, &args, sizeof(args));
+#else
+    (void)group;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int joinCgroup(const Cgroup_t* group, pid_t pid) {
+    char digits[16];
+    char* start = digits + sizeof(digits);
+    unsigned long value = (unsigned long)pid;
+
+    // Format by hand: a forked child may only call async-signal-safe functions
+    do {
+        *(--start) = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+
+    ssize_t len = digits + sizeof(digits) - start;
+
+    return write(group->procsFd, start, len) == len;
+}
+
+/**
+ * Prints the "some" and "full" stall totals of one pressure file.
+ *
+ * @param group the group the file belongs to
+ * @param resource cpu, memory or io
+ * @param out the stream to print to
+ */
+static void reportResourcePressure(const Cgroup_t* group, const char* resource, FILE* out) {
+    char path[CGROUP_PATH_BYTES];
+    char contents[CGROUP_FILE_BYTES];
+    double someSecs = 0, fullSecs = 0;
+    ssize_t len;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/%s.pressure", group->path, resource);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1) {
+        fprintf(out, "  %-6s unavailable\n", resource);
+        return;
+    }
+
+    len = read(fd, contents, sizeof(contents)-1);
+    close(fd);
+    contents[(len > 0) ? len : 0] = '\0';
+
+    // Each line reads: some|full avg10=.. avg60=.. avg300=.. total=<usecs>
+    char* save;
+    char* line = strtok_r(contents, "\n", &save);
+    while (line != NULL) {
+        const char* total = strstr(line, "total=");
+
+        if (total != NULL) {
+            double secs = atof(total + strlen("total=")) / 1e6;
+
+            if (strncmp(line, "some", 4) == 0) someSecs = secs;
+            else if (strncmp(line, "full", 4) == 0) fullSecs = secs;
+        }
+
+        line = strtok_r(NULL, "\n", &save);
+    }
+
+    fprintf(out, "  %-6s some %.3fs full %.3fs\n", resource, someSecs, fullSecs);
+}
+
+void reportPressure(const Cgroup_t* group, FILE* out) {
+    fprintf(out, "Pressure stalls of %s:\n", group->path);
+    reportResourcePressure(group, "cpu", out);
+    reportResourcePressure(group, "memory", out);
+    reportResourcePressure(group, "io", out);
+}
+
+void removeCgroup(Cgroup_t* group) {
+    if (group->procsFd != -1) {
+        close(group->procsFd);
+        group->procsFd = -1;
+    }
+
+    if (group->dirFd != -1) {
+        close(group->dirFd);
+        group->dirFd = -1;
+    }
+
+    if (group->path != NULL) {
+        // Reaped children have already left, so the group is empty
+        if (rmdir(group->path) == -1) {
+            printf("Removing the cgroup %s has failed.\n", group->path);
+        }
+
+        free(group->path);
+        group->path = NULL;
+    }
+}
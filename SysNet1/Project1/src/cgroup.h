@@ -0,0 +1,121 @@
+/**
+ * File:   cgroup.h
+ *
+ * cgroup.h holds the tools myshell uses to fence off the processes of one
+ * command. Each launched command (all of its instances and pipeline stages)
+ * can be placed in its own cgroup v2 group, created below a parent group the
+ * user owns (e.g. one delegated by systemd). The group can limit the CPU
+ * bandwidth (cpu.max), the memory (memory.max) and the CPUs (cpuset.cpus) of
+ * the whole fan-out, so it can share a host with latency-sensitive services.
+ *
+ * When the command finishes, the pressure stall information (PSI) of the
+ * group is reported: how long some (or all) of its processes were stalled
+ * waiting for CPU, memory or I/O. The group is then removed.
+ *
+ * @author Adam Mooers
+ * @author Luke Kledzik
+ * @date 9/18/2016
+ * @info Course COP4634
+ */
+
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+/**
+ * The period, in microseconds, used for the cpu.max bandwidth limit.
+ */
+#define CPU_MAX_PERIOD_US 100000
+
+/**
+ * This struct holds the limits applied to the group of every command.
+ *
+ * parent is the cgroup v2 directory the groups are created in, or NULL to not use cgroups.
+ * cpuLimit is the number of CPUs worth of bandwidth the group may use, or 0 for no limit.
+ * memoryMax is the memory.max value of the group (e.g. 512M), or NULL for no limit.
+ * cpus is the cpuset.cpus list of the group (e.g. 0-3,6), or NULL for no pinning.
+ */
+struct CGROUP_LIMITS {
+    const char *parent;     /* cgroup v2 parent directory or NULL */
+    double     cpuLimit;    /* CPUs of bandwidth, 0 for unlimited */
+    const char *memoryMax;  /* memory.max or NULL */
+    const char *cpus;       /* cpuset.cpus or NULL */
+};
+
+/**
+ * Typedef for the CGROUP_LIMITS struct. CgroupLimits_t is now usable instead of struct CGROUP_LIMITS.
+ */
+typedef struct CGROUP_LIMITS CgroupLimits_t;
+
+/**
+ * This struct holds one group created by createCgroup(...).
+ *
+ * path is the directory of the group, or NULL if there is no group.
+ * procsFd is the open cgroup.procs file of the group, or -1. It is close-on-exec.
+ * dirFd is the open directory of the group, or -1. It is close-on-exec.
+ */
+struct CGROUP {
+    char *path;     /* group directory or NULL */
+    int  procsFd;   /* cgroup.procs, write-only */
+    int  dirFd;     /* group directory, for CLONE_INTO_CGROUP */
+};
+
+/**
+ * Typedef for the CGROUP struct. Cgroup_t is now usable instead of struct CGROUP.
+ */
+typedef struct CGROUP Cgroup_t;
+
+/**
+ * Creates a new group below limits->parent and applies the limits. The
+ * controllers the limits need are enabled in the parent first. An error is
+ * printed if a controller cannot be enabled (e.g. EBUSY, since the parent
+ * itself holds processes), the group cannot be created or a limit cannot be
+ * applied.
+ *
+ * @param limits the parent directory and the limits
+ * @param group the group to fill
+ * @return 1 if successful, 0 otherwise (nothing is left behind)
+ */
+int createCgroup(const CgroupLimits_t* limits, Cgroup_t* group);
+
+/**
+ * Creates a child process like fork(), but directly inside a group, so the
+ * child never runs outside of it (clone3 with CLONE_INTO_CGROUP, Linux 5.7).
+ *
+ * @param group the group to create the child in
+ * @return the pid of the child in the parent, 0 in the child, or -1 if the
+ *         child could not be created (errno is ENOSYS on kernels without
+ *         clone3 or CLONE_INTO_CGROUP)
+ */
+pid_t forkIntoCgroup(const Cgroup_t* group);
+
+/**
+ * Moves a process into a group. A forked child can pass 0 to move itself
+ * before it calls exec, so not a single instruction of the program runs outside
+ * the group. This is async-signal-safe.
+ *
+ * @param group the group to join
+ * @param pid the process to move, or 0 for the caller
+ * @return 1 if successful, 0 otherwise
+ */
+int joinCgroup(const Cgroup_t* group, pid_t pid);
+
+/**
+ * Prints the total stall time of a group for CPU, memory and I/O, as "some"
+ * (at least one process stalled) and "full" (all processes stalled) seconds.
+ *
+ * @param group the group to report on
+ * @param out the stream to print to
+ */
+void reportPressure(const Cgroup_t* group, FILE* out);
+
+/**
+ * Removes an empty group and releases it.
+ *
+ * @param group the group to remove
+ */
+void removeCgroup(Cgroup_t* group);
+
+#endif
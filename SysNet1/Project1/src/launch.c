@@ -0,0 +1,1055 @@
+/**
+ * File: launch.c
+ *
+ * Implements launch.h. See launch.h for details.
+ *
+ * @author Adam Mooers
+ * @author Luke Kledzik
+ * @date 9/18/2016
+ * @info Course COP4634
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/pidfd.h>
+#include <sys/resource.h>
+#include "launch.h"
+
+/*
+ * Permissions given to a newly-created output redirect file (before the umask)
+ */
+#define REDIRECT_FILE_MODE 0666
+
+/*
+ * Capacity requested for each pipe between stages. Larger pipes let a stage
+ * run further ahead of its consumer and let splice move bigger chunks.
+ */
+#define PIPE_BUFFER_BYTES (1024*1024)
+
+/*
+ * Size of the buffer used to concatenate per-instance output files
+ */
+#define MERGE_BUFFER_BYTES (64*1024)
+
+/*
+ * Number of events the supervisor handles per epoll_wait
+ */
+#define SUPERVISOR_EVENTS 8
+
+/*
+ * Size of one slice environment variable, e.g. MYSHELL_LO=123
+ */
+#define SLICE_ENV_BYTES 64
+
+/**
+ * Describes where the standard streams of one launched process come from and
+ * go to. A valid pipe end takes precedence over the matching file redirect;
+ * streams that are not replaced are inherited from myshell.
+ */
+struct STREAMS {
+    int inFd;                    /* read end of the upstream pipe or -1 */
+    int outFd;                   /* write end of the downstream pipe or -1 */
+    const char* inputRedirect;   /* file name or NULL, used when inFd is -1 */
+    const char* outputRedirect;  /* file name or NULL, used when outFd is -1 */
+    int truncateOutput;          /* replace outputRedirect instead of appending */
+};
+
+typedef struct STREAMS Streams_t;
+
+/**
+ * Launches one process of one pipeline stage.
+ *
+ * @param argv the NULL-terminated argument vector of the process
+ * @param streams the standard streams of the process
+ * @param group the group to run the process in, or NULL
+ * @param launchMode LAUNCH_FORK or LAUNCH_SPAWN
+ * @return the pid of the new process, or -1 if it could not be launched
+ */
+static pid_t launchProcess(char** argv, char** envp, const Streams_t* streams,
+                           const Cgroup_t* group, int launchMode);
+
+/**
+ * The fork-exec launch path. The child is created inside its group (or, on
+ * kernels without CLONE_INTO_CGROUP, joins it first thing) and redirects its
+ * standard streams before calling execve.
+ */
+static pid_t forkProcess(char** argv, char** envp, const Streams_t* streams, const Cgroup_t* group);
+
+/**
+ * The posix_spawn launch path. The redirects are handed to the
+ * child as spawn file actions. posix_spawn can only start the child in its
+ * group with POSIX_SPAWN_SETCGROUP (glibc 2.39); otherwise a child with a
+ * group is launched with forkProcess(...).
+ */
+static pid_t spawnProcess(char** argv, char** envp, const Streams_t* streams, const Cgroup_t* group);
+
+/**
+ * Launches one copy of the whole pipeline for an index and records its processes.
+ *
+ * @param job the job the index belongs to
+ * @param i the index to launch
+ * @return 1 if every stage was launched, 0 otherwise
+ */
+static int launchInstance(Job_t* job, int i);
+
+/**
+ * Computes the slice of every index and the environment that carries it
+ * (see split.h).
+ *
+ * @param job the job to split, with its arena built
+ * @return 1 if successful, 0 if the slices could not be allocated
+ */
+static int buildSlices(Job_t* job);
+
+/**
+ * Adds a launched process to the pid lookup of a job, keeping it sorted by pid.
+ */
+static void insertPidSlot(Job_t* job, pid_t pid, int slot);
+
+/**
+ * Releases everything a job holds, including the job itself.
+ */
+static void freeJob(Job_t* job);
+
+/**
+ * Stores the status and resource usage of a reaped child in the record of the
+ * job it belongs to, and launches the next index if its instance has finished.
+ *
+ * @param jobs the jobs the child may belong to
+ * @param count the number of jobs
+ * @param pid the reaped child
+ * @param status the wait status of the child
+ * @param usage the resource usage of the child
+ * @param reaped set to the record of the child
+ * @return the job the child belongs to, or NULL if it belongs to none of them
+ */
+static Job_t* recordChild(Job_t** jobs, int count, pid_t pid, int status,
+                          const struct rusage* usage, ChildStat_t** reaped);
+
+/**
+ * Determines if every process of a job has been reaped and no more will be launched.
+ */
+static int jobDone(const Job_t* job);
+
+/**
+ * Creates a pipe between two stages. Both ends are close-on-exec so that
+ * only the dup2'd copies survive in the children.
+ *
+ * @param fds the read and write ends of the new pipe
+ * @return 1 if successful, 0 otherwise
+ */
+static int openStagePipe(int fds[2]);
+
+/**
+ * Appends the per-instance output files to a single file in index order.
+ * Files that do not exist (e.g. for instances that never launched) are skipped.
+ *
+ * @param arena the arena holding the expanded output file names
+ * @param count the number of instances that were launched
+ * @param mergeRedirect the file to append to
+ */
+static void mergeOutputs(const ArgvArena_t* arena, int count, const char* mergeRedirect);
+
+/**
+ * Returns the number of seconds between two CLOCK_MONOTONIC times.
+ */
+static double elapsedSecs(const struct timespec* start, const struct timespec* finish);
+
+/**
+ * Orders PidSlot_t entries by pid for bsearch.
+ */
+static int comparePidSlots(const void* a, const void* b);
+
+extern char **environ;
+
+void execCmd(int n, const Pipeline_t* pipeline, const LaunchOptions_t* options) {
+    Job_t* job = launchJob(n, pipeline, options);
+
+    if (job != NULL) {
+        // Wait for all successful children to finish before returning
+        waitJobs(&job, 1);
+        finishJob(job);
+    }
+}
+
+Job_t* launchJob(int n, const Pipeline_t* pipeline, const LaunchOptions_t* options) {
+    int oversplit = (options->oversplit > 1) ? options->oversplit : 1;
+
+    // Every slice is an int index
+    if (n > INT_MAX / oversplit) {
+        printf("Too many instances: %d times an oversplit of %d.\n", n, oversplit);
+        return NULL;
+    }
+
+    Job_t* job = (Job_t*)calloc(1, sizeof(Job_t));
+
+    if (job == NULL) {
+        printf("Unable to allocate the job.\n");
+        return NULL;
+    }
+
+    // The job keeps its own argument vectors so the caller may reuse its pipeline
+    if (!copyPipeline(pipeline, &job->pipeline)) {
+        printf("Unable to allocate the argument vectors.\n");
+        free(job);
+        return NULL;
+    }
+    job->options = *options;
+    job->cgroup.procsFd = -1;
+    job->cgroup.dirFd = -1;
+    pipeline = &job->pipeline;
+
+    const Param_t* first = &pipeline->stages[0];
+    const Param_t* last = &pipeline->stages[pipeline->stageCount-1];
+    const char* outputTemplate = isIndexTemplate(last->outputRedirect) ? last->outputRedirect : NULL;
+    int slices = n * oversplit;
+    int i;
+
+    // Build every argument vector (and output name) before the first child starts
+    if (!buildArgvArena(first, outputTemplate, slices, &job->arena)) {
+        printf("Unable to allocate the argument vectors.\n");
+        freeJob(job);
+        return NULL;
+    }
+
+    // Files left by an earlier run (e.g. of an index that fails to launch now)
+    // must not end up in this run's merge
+    for (i=0; job->arena.outputNames != NULL && i<slices; i++) {
+        unlink(childOutput(&job->arena, i));
+    }
+
+    // One accounting record and one lookup slot per launched process
+    size_t maxProcs = (size_t)slices*pipeline->stageCount;
+    job->stats = (ChildStat_t*)calloc(maxProcs, sizeof(ChildStat_t));
+    job->slots = (PidSlot_t*)malloc(maxProcs*sizeof(PidSlot_t));
+    job->stagesLeft = (int*)calloc(slices, sizeof(int));
+    job->pidFds = (int*)malloc(maxProcs*sizeof(int));
+
+    if (job->stats == NULL || job->slots == NULL || job->stagesLeft == NULL || job->pidFds == NULL) {
+        printf("Unable to allocate the child statistics.\n");
+        freeJob(job);
+        return NULL;
+    }
+
+    for (i=0; i<(int)maxProcs; i++) {
+        job->pidFds[i] = -1;
+    }
+
+    if (options->splitMode != SPLIT_NONE && !buildSlices(job)) {
+        printf("Unable to allocate the slices.\n");
+        freeJob(job);
+        return NULL;
+    }
+
+    if (options->cgroup.parent != NULL && !createCgroup(&options->cgroup, &job->cgroup)) {
+        freeJob(job);
+        return NULL;
+    }
+
+    // The deadline counts from the launch of the first instance
+    clock_gettime(CLOCK_MONOTONIC, &job->deadline);
+    job->deadline.tv_sec += (time_t)options->timeoutSecs;
+    job->deadline.tv_nsec += (long)((options->timeoutSecs - (time_t)options->timeoutSecs) * 1e9);
+    if (job->deadline.tv_nsec >= 1000000000L) {
+        job->deadline.tv_sec++;
+        job->deadline.tv_nsec -= 1000000000L;
+    }
+
+    // Forked children would otherwise flush the shell's buffered output again
+    fflush(stdout);
+
+    // Launch one copy of the whole pipeline for each of the first n indexes,
+    // waitJobs launches the rest as they free up
+    job->maxRunning = n;
+    for (i=0; i<n && i<slices && !job->cancelled; i++) {
+        launchInstance(job, i);
+    }
+
+    return job;
+}
+
+static int launchInstance(Job_t* job, int i) {
+    const Pipeline_t* pipeline = &job->pipeline;
+    const Param_t* last = &pipeline->stages[pipeline->stageCount-1];
+    int inFd = -1; // Read end of the pipe feeding the current stage
+    int k;
+
+    job->instanceCount = i+1;
+
+    for (k=0; k<pipeline->stageCount; k++) {
+        const Param_t* stage = &pipeline->stages[k];
+        int fds[2] = { -1, -1 };
+
+        // Every stage but the last feeds the next one through a pipe
+        if (k < pipeline->stageCount-1 && !openStagePipe(fds)) {
+            printf("Unable to create a pipe. Cancelling queue.\n");
+            break;
+        }
+
+        // Each instance owns its templated output file, so it starts empty
+        Streams_t streams = { inFd, fds[1], stage->inputRedirect, stage->outputRedirect, 0 };
+
+        if (stage == last && job->arena.outputNames != NULL) {
+            streams.outputRedirect = childOutput(&job->arena, i);
+            streams.truncateOutput = 1;
+        }
+
+        // Only the first stage receives the index and the slice
+        char** argv = (k == 0) ? childArgV(&job->arena, i) : (char**)stage->argumentVector;
+        char** envp = (k == 0 && job->slices != NULL) ? job->envp : environ;
+        ChildStat_t* stat = &job->stats[job->launchCount];
+
+        if (envp != environ) {
+            // The child gets its own copy, so the variables can be reused for the next launch
+            snprintf(envp[0], SLICE_ENV_BYTES, "%s=%ld", SPLIT_LO_ENV, job->slices[i].lo);
+            snprintf(envp[1], SLICE_ENV_BYTES, "%s=%ld", SPLIT_HI_ENV, job->slices[i].hi);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &stat->start);
+        pid_t pid = launchProcess(argv, envp, &streams,
+            (job->cgroup.path != NULL) ? &job->cgroup : NULL, job->options.launchMode);
+
+        // The children hold their own copies of the pipe ends now
+        if (inFd != -1) close(inFd);
+        if (fds[1] != -1) close(fds[1]);
+        inFd = fds[0];
+
+        if (pid == -1) {
+            printf("Unable to launch the %d process. Cancelling queue.\n", job->launchCount);
+            break;
+        }
+
+        stat->pid = pid;
+        stat->index = i;
+        stat->stage = k;
+        insertPidSlot(job, pid, job->launchCount);
+        job->stagesLeft[i]++;
+        job->launchCount++;
+    }
+
+    if (inFd != -1) close(inFd);
+
+    if (job->stagesLeft[i] > 0) {
+        job->runningCount++;
+    }
+
+    // Stop launching if the current pipeline is incomplete
+    if (k < pipeline->stageCount) {
+        job->cancelled = 1;
+        return 0;
+    }
+
+    return 1;
+}
+
+static int buildSlices(Job_t* job) {
+    const Param_t* first = &job->pipeline.stages[0];
+    int count = job->arena.count;
+    int envCount = 0;
+    int e;
+
+    while (environ[envCount] != NULL) {
+        envCount++;
+    }
+
+    // The two slice variables, the inherited environment, the NULL and the
+    // storage of the slice variables (rewritten for every launch)
+    job->slices = (Slice_t*)malloc(sizeof(Slice_t)*count);
+    job->envp = (char**)malloc(sizeof(char*)*(envCount+3) + 2*SLICE_ENV_BYTES);
+
+    if (job->slices == NULL || job->envp == NULL) {
+        return 0;
+    }
+
+    // The children work on the values [0, value), value being the first child_argument,
+    // the same range they share out among themselves without a split
+    long value = (first->argumentCount > 2) ? atol(first->argumentVector[2]) : 0;
+    computeSlices(0, value, count, job->options.splitMode, job->options.costExponent, job->slices);
+
+    char* sliceStrings = (char*)(job->envp + envCount+3);
+    char** envPtr = job->envp;
+    *(envPtr++) = sliceStrings;
+    *(envPtr++) = sliceStrings + SLICE_ENV_BYTES;
+
+    // Leave out any slice variables myshell itself inherited
+    for (e=0; e<envCount; e++) {
+        if (strncmp(environ[e], SPLIT_LO_ENV "=", strlen(SPLIT_LO_ENV)+1) != 0 &&
+            strncmp(environ[e], SPLIT_HI_ENV "=", strlen(SPLIT_HI_ENV)+1) != 0) {
+            *(envPtr++) = environ[e];
+        }
+    }
+
+    *envPtr = NULL;
+
+    return 1;
+}
+
+static void insertPidSlot(Job_t* job, pid_t pid, int slot) {
+    int pos = job->launchCount;
+
+    // Pids mostly increase, so the new slot usually belongs at the end
+    while (pos > 0 && job->slots[pos-1].pid > pid) {
+        job->slots[pos] = job->slots[pos-1];
+        pos--;
+    }
+
+    job->slots[pos].pid = pid;
+    job->slots[pos].slot = slot;
+}
+
+void finishJob(Job_t* job) {
+    const Param_t* first = &job->pipeline.stages[0];
+    const Param_t* last = &job->pipeline.stages[job->pipeline.stageCount-1];
+
+    if (job->options.printStats) {
+        printStatsTable(job->stats, job->launchCount, stdout);
+    }
+
+    if (job->options.statsCsv != NULL) {
+        appendStatsCsv(job->options.statsCsv, first->argumentVector[0], job->stats, job->launchCount);
+    }
+
+    if (last->mergeRedirect != NULL && job->arena.outputNames != NULL) {
+        mergeOutputs(&job->arena, job->instanceCount, last->mergeRedirect);
+    }
+
+    if (job->cgroup.path != NULL) {
+        reportPressure(&job->cgroup, stdout);
+    }
+
+    freeJob(job);
+}
+
+static void freeJob(Job_t* job) {
+    if (job->cgroup.path != NULL) {
+        removeCgroup(&job->cgroup);
+    }
+    int k;
+
+    // Only the pidfds of children that were never reaped are still open
+    for (k=0; job->pidFds != NULL && k<job->launchCount; k++) {
+        if (job->pidFds[k] != -1) close(job->pidFds[k]);
+    }
+    free(job->pidFds);
+    free(job->stagesLeft);
+    free(job->envp);
+    free(job->slices);
+    free(job->slots);
+    free(job->stats);
+    freeArgvArena(&job->arena);
+    freePipeline(&job->pipeline);
+    free(job);
+}
+
+static pid_t launchProcess(char** argv, char** envp, const Streams_t* streams,
+                           const Cgroup_t* group, int launchMode) {
+    if (launchMode == LAUNCH_SPAWN) {
+        return spawnProcess(argv, envp, streams, group);
+    }
+
+    return forkProcess(argv, envp, streams, group);
+}
+
+static pid_t forkProcess(char** argv, char** envp, const Streams_t* streams, const Cgroup_t* group) {
+    pid_t pid = -1;
+    int joined = 0;
+
+    if (group != NULL) {
+        pid = forkIntoCgroup(group);
+        joined = (pid != -1);
+    }
+
+    // Older kernels cannot create the child in the group
+    if (pid == -1 && (group == NULL || errno == ENOSYS || errno == E2BIG || errno == EINVAL)) {
+        pid = fork();
+    }
+
+    if (pid == 0) {
+        // If in child process
+        int redirected;
+
+        // The supervisor's blocked SIGCHLD must not leak into the program
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGCHLD);
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+        // Join the group before the program can allocate or burn any CPU
+        if (group != NULL && !joined && !joinCgroup(group, 0)) {
+            printf("Joining the cgroup %s has failed.\n", group->path);
+            exit(0);
+        }
+
+        // The pipes take the place of the file redirects
+        if (streams->inFd != -1) {
+            redirected = dup2(streams->inFd, STDIN_FILENO) != -1;
+        }
+        else {
+            redirected = redirFile(streams->inputRedirect, "rb", stdin);
+        }
+
+        if (streams->outFd != -1) {
+            redirected = redirected && dup2(streams->outFd, STDOUT_FILENO) != -1;
+        }
+        else {
+            redirected = redirected && redirFile(streams->outputRedirect,
+                streams->truncateOutput ? "w" : "a", stdout);
+        }
+
+        if (redirected) {
+            // Launch the new exec
+            execve(*argv, argv, envp);
+        }
+
+        printf("Exec has failed to launch a new process.\n");
+
+        // Stop-gap fork bomb stopper, in case of a exec error
+        exit(0);
+    }
+
+    return pid;
+}
+
+static pid_t spawnProcess(char** argv, char** envp, const Streams_t* streams, const Cgroup_t* group) {
+#ifndef POSIX_SPAWN_SETCGROUP
+    // The child must not run a single instruction outside of its group
+    if (group != NULL) {
+        return forkProcess(argv, envp, streams, group);
+    }
+#endif
+
+    posix_spawn_file_actions_t fileActions;
+    posix_spawn_file_actions_init(&fileActions);
+
+    // The pipes take the place of the file redirects
+    if (streams->inFd != -1) {
+        posix_spawn_file_actions_adddup2(&fileActions, streams->inFd, STDIN_FILENO);
+    }
+    else if (streams->inputRedirect != NULL) {
+        posix_spawn_file_actions_addopen(&fileActions, STDIN_FILENO,
+            streams->inputRedirect, O_RDONLY, 0);
+    }
+
+    if (streams->outFd != -1) {
+        posix_spawn_file_actions_adddup2(&fileActions, streams->outFd, STDOUT_FILENO);
+    }
+    else if (streams->outputRedirect != NULL) {
+        // Open with append permissions to prevent overwriting a shared file
+        posix_spawn_file_actions_addopen(&fileActions, STDOUT_FILENO,
+            streams->outputRedirect,
+            O_WRONLY | O_CREAT | (streams->truncateOutput ? O_TRUNC : O_APPEND),
+            REDIRECT_FILE_MODE);
+    }
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+
+    // The supervisor's blocked SIGCHLD must not leak into the program
+    sigset_t mask;
+    sigprocmask(SIG_BLOCK, NULL, &mask);
+    sigdelset(&mask, SIGCHLD);
+    posix_spawnattr_setsigmask(&attr, &mask);
+
+    short flags = POSIX_SPAWN_SETSIGMASK;
+#ifdef POSIX_SPAWN_USEVFORK
+    // Older glibc versions only avoid copying the parent when asked to
+    flags |= POSIX_SPAWN_USEVFORK;
+#endif
+#ifdef POSIX_SPAWN_SETCGROUP
+    if (group != NULL) {
+        posix_spawnattr_setcgroup_np(&attr, group->dirFd);
+        flags |= POSIX_SPAWN_SETCGROUP;
+    }
+#endif
+    posix_spawnattr_setflags(&attr, flags);
+
+    pid_t pid;
+    int status = posix_spawn(&pid, *argv, &fileActions, &attr, argv, envp);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&fileActions);
+
+    // A failed spawn includes failed redirects
+    return (status == 0) ? pid : -1;
+}
+
+static int openStagePipe(int fds[2]) {
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        return 0;
+    }
+
+#ifdef F_SETPIPE_SZ
+    // Best effort: the default capacity still works, just with more context switches
+    fcntl(fds[1], F_SETPIPE_SZ, PIPE_BUFFER_BYTES);
+#endif
+
+    return 1;
+}
+
+static void mergeOutputs(const ArgvArena_t* arena, int count, const char* mergeRedirect) {
+    char buffer[MERGE_BUFFER_BYTES];
+    int i;
+
+    int mergeFd = open(mergeRedirect, O_WRONLY | O_CREAT | O_APPEND, REDIRECT_FILE_MODE);
+
+    if (mergeFd == -1) {
+        printf("Redirecting to %s has failed.\n", mergeRedirect);
+        return;
+    }
+
+    // Concatenate the files in index order for a deterministic result
+    for (i=0; i<count; i++) {
+        int partFd = open(childOutput(arena, i), O_RDONLY);
+        ssize_t len;
+
+        if (partFd == -1) {
+            continue;
+        }
+
+        while ((len = read(partFd, buffer, sizeof(buffer))) > 0) {
+            if (write(mergeFd, buffer, len) != len) {
+                printf("Merging into %s has failed.\n", mergeRedirect);
+                break;
+            }
+        }
+
+        close(partFd);
+    }
+
+    close(mergeFd);
+}
+
+static Job_t* recordChild(Job_t** jobs, int count, pid_t pid, int status,
+                          const struct rusage* usage, ChildStat_t** reaped) {
+    PidSlot_t key;
+    struct timespec finish;
+    int j;
+
+    key.pid = pid;
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+
+    // The processes close in any order, and may belong to any job
+    for (j=0; j<count; j++) {
+        Job_t* job = jobs[j];
+        PidSlot_t* match = (PidSlot_t*)bsearch(&key, job->slots, job->launchCount,
+                                               sizeof(PidSlot_t), comparePidSlots);
+
+        if (match == NULL) {
+            continue;
+        }
+
+        ChildStat_t* stat = &job->stats[match->slot];
+
+        stat->status = status;
+        stat->reaped = 1;
+        stat->wallSecs = elapsedSecs(&stat->start, &finish);
+        stat->userSecs = usage->ru_utime.tv_sec + usage->ru_utime.tv_usec / 1e6;
+        stat->sysSecs = usage->ru_stime.tv_sec + usage->ru_stime.tv_usec / 1e6;
+        stat->maxRssKb = usage->ru_maxrss;
+
+        job->reapCount++;
+
+        // A finished instance frees its place for the next index
+        if (--job->stagesLeft[stat->index] == 0) {
+            job->runningCount--;
+
+            while (job->runningCount < job->maxRunning && !job->cancelled &&
+                   job->instanceCount < job->arena.count) {
+                fflush(stdout);
+                launchInstance(job, job->instanceCount);
+            }
+        }
+
+        *reaped = stat;
+        return job;
+    }
+
+    return NULL;
+}
+
+static int jobDone(const Job_t* job) {
+    return job->reapCount == job->launchCount &&
+           (job->cancelled || job->instanceCount == job->arena.count);
+}
+
+void waitJobs(Job_t** jobs, int count) {
+    Supervisor_t supervisor;
+    int j;
+
+    if (openSupervisor(&supervisor, 0, 0)) {
+        for (j=0; j<count; j++) {
+            superviseJob(&supervisor, jobs[j]);
+        }
+
+        runSupervisor(&supervisor, -1);
+        closeSupervisor(&supervisor);
+        return;
+    }
+
+    // Without a signalfd, fall back to a blocking wait (and no deadlines)
+    // Use ps-axu | grep "Z" in terminal to view potential zombies
+    while (1) {
+        struct rusage usage;
+        ChildStat_t* stat;
+        int status;
+        int done = 1;
+
+        for (j=0; j<count; j++) {
+            done = done && jobDone(jobs[j]);
+        }
+
+        if (done) {
+            break;
+        }
+
+        pid_t pid = wait4(-1, &status, 0, &usage);
+
+        if (pid == -1) {
+            break; // No children left
+        }
+
+        recordChild(jobs, count, pid, status, &usage, &stat);
+    }
+}
+
+int openSupervisor(Supervisor_t* supervisor, int streamStatus, int finishJobs) {
+    struct epoll_event event;
+    sigset_t mask;
+
+    memset(supervisor, 0, sizeof(Supervisor_t));
+    supervisor->streamStatus = streamStatus;
+    supervisor->finishJobs = finishJobs;
+    supervisor->nextId = 1;
+
+    // SIGCHLD is only ever received through the signalfd
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &supervisor->oldMask);
+
+    supervisor->signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    supervisor->epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    event.events = EPOLLIN;
+    event.data.fd = supervisor->signalFd;
+
+    if (supervisor->signalFd == -1 || supervisor->epollFd == -1 ||
+        epoll_ctl(supervisor->epollFd, EPOLL_CTL_ADD, supervisor->signalFd, &event) == -1) {
+        printf("Unable to create the child supervisor.\n");
+        closeSupervisor(supervisor);
+        return 0;
+    }
+
+    return 1;
+}
+
+int superviseJob(Supervisor_t* supervisor, Job_t* job) {
+    if (supervisor->jobCount == supervisor->jobCapacity) {
+        int capacity = (supervisor->jobCapacity > 0) ? supervisor->jobCapacity*2 : 16;
+        Job_t** grown = (Job_t**)realloc(supervisor->jobs, sizeof(Job_t*)*capacity);
+
+        if (grown == NULL) {
+            return 0;
+        }
+
+        supervisor->jobs = grown;
+        supervisor->jobCapacity = capacity;
+    }
+
+    job->id = supervisor->nextId++;
+    supervisor->jobs[supervisor->jobCount++] = job;
+
+    return 1;
+}
+
+/**
+ * Opens a pidfd for every launched child of the supervised jobs that has none
+ * yet and adds it to the epoll instance, while fewer than MAX_SUPERVISOR_PIDFDS
+ * are open. The children left without one are noticed through SIGCHLD.
+ *
+ * @param supervisor the supervisor whose jobs to watch
+ */
+static void watchChildren(Supervisor_t* supervisor) {
+    struct epoll_event event;
+    int j;
+
+    for (j=0; j<supervisor->jobCount; j++) {
+        Job_t* job = supervisor->jobs[j];
+
+        while (job->watchCount < job->launchCount && supervisor->pidFdCount < MAX_SUPERVISOR_PIDFDS) {
+            int k = job->watchCount++;
+
+            if (job->stats[k].reaped) {
+                continue;
+            }
+
+            // Unreaped children still exist (possibly as zombies), so their pids are valid
+            int pidFd = pidfd_open(job->stats[k].pid, 0);
+
+            if (pidFd == -1) {
+                continue;
+            }
+
+            event.events = EPOLLIN;
+            event.data.fd = pidFd;
+
+            if (epoll_ctl(supervisor->epollFd, EPOLL_CTL_ADD, pidFd, &event) == -1) {
+                close(pidFd);
+                continue;
+            }
+
+            job->pidFds[k] = pidFd;
+            supervisor->pidFdCount++;
+        }
+    }
+}
+
+/**
+ * Reaps every child that has ended, without blocking, and closes their pidfds.
+ *
+ * @param supervisor the supervisor whose jobs the children belong to
+ */
+static void reapChildren(Supervisor_t* supervisor) {
+    struct rusage usage;
+    ChildStat_t* stat;
+    char statusStr[32];
+    int status;
+    pid_t pid;
+
+    while ((pid = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+        Job_t* job = recordChild(supervisor->jobs, supervisor->jobCount, pid, status, &usage, &stat);
+        int* pidFd = (job != NULL) ? &job->pidFds[stat - job->stats] : NULL;
+
+        if (pidFd != NULL && *pidFd != -1) {
+            // A forked child may still hold a copy, which would keep the registration alive
+            epoll_ctl(supervisor->epollFd, EPOLL_CTL_DEL, *pidFd, NULL);
+            close(*pidFd);
+            *pidFd = -1;
+            supervisor->pidFdCount--;
+        }
+
+        if (job != NULL && supervisor->streamStatus) {
+            formatChildStatus(stat, statusStr, sizeof(statusStr));
+            printf("[%d] %s index %d stage %d pid %d: %s after %.3fs\n",
+                job->id, job->pipeline.stages[0].argumentVector[0],
+                stat->index, stat->stage, (int)pid, statusStr, stat->wallSecs);
+        }
+    }
+
+    // Freed pidfds go to children that had none, and to the newly launched indexes
+    watchChildren(supervisor);
+}
+
+/**
+ * Kills the remaining processes of every job that has passed its deadline
+ * and returns the time until the next deadline.
+ *
+ * @param supervisor the supervisor whose jobs to check
+ * @return the milliseconds until the next deadline, or -1 if there is none
+ */
+static int killOverdueJobs(Supervisor_t* supervisor) {
+    struct timespec now;
+    int timeoutMs = -1;
+    int j, k;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    for (j=0; j<supervisor->jobCount; j++) {
+        Job_t* job = supervisor->jobs[j];
+
+        if (job->options.timeoutSecs <= 0 || job->timedOut || jobDone(job)) {
+            continue;
+        }
+
+        double left = elapsedSecs(&now, &job->deadline);
+
+        if (left > 0) {
+            // Round up so the loop never wakes just before the deadline
+            int leftMs = (int)(left*1000) + 1;
+            if (timeoutMs == -1 || leftMs < timeoutMs) timeoutMs = leftMs;
+            continue;
+        }
+
+        // Stragglers are killed and no further indexes are started
+        job->timedOut = 1;
+        job->cancelled = 1;
+
+        for (k=0; k<job->launchCount; k++) {
+            ChildStat_t* stat = &job->stats[k];
+
+            if (!stat->reaped) {
+                stat->timedOut = 1;
+                kill(stat->pid, SIGKILL);
+            }
+        }
+
+        printf("[%d] %s passed its deadline of %.3fs and was killed.\n",
+            job->id, job->pipeline.stages[0].argumentVector[0], job->options.timeoutSecs);
+    }
+
+    return timeoutMs;
+}
+
+/**
+ * Finishes (reports and releases) every job whose children have all been
+ * reaped, keeping the remaining jobs in launch order.
+ *
+ * @param supervisor the supervisor whose jobs to finish
+ */
+static void finishDoneJobs(Supervisor_t* supervisor) {
+    int kept = 0;
+    int j;
+
+    for (j=0; j<supervisor->jobCount; j++) {
+        Job_t* job = supervisor->jobs[j];
+
+        if (!jobDone(job)) {
+            supervisor->jobs[kept++] = job;
+            continue;
+        }
+
+        if (supervisor->streamStatus) {
+            printf("[%d] %s done: %d processes\n", job->id,
+                job->pipeline.stages[0].argumentVector[0], job->launchCount);
+        }
+
+        finishJob(job);
+    }
+
+    supervisor->jobCount = kept;
+}
+
+int runSupervisor(Supervisor_t* supervisor, int inputFd) {
+    struct epoll_event events[SUPERVISOR_EVENTS];
+    struct signalfd_siginfo info;
+    int inputReady = 0;
+    int j, e;
+
+    if (inputFd != -1) {
+        struct epoll_event event;
+
+        event.events = EPOLLIN;
+        event.data.fd = inputFd;
+        epoll_ctl(supervisor->epollFd, EPOLL_CTL_ADD, inputFd, &event);
+    }
+
+    while (!inputReady) {
+        // Children may have ended before SIGCHLD was blocked, so always look first
+        reapChildren(supervisor);
+        int timeoutMs = killOverdueJobs(supervisor);
+
+        if (supervisor->finishJobs) {
+            finishDoneJobs(supervisor);
+        }
+
+        if (inputFd == -1) {
+            int done = 1;
+
+            for (j=0; j<supervisor->jobCount; j++) {
+                done = done && jobDone(supervisor->jobs[j]);
+            }
+
+            if (done) {
+                break;
+            }
+        }
+
+        fflush(stdout);
+        int eventCount = epoll_wait(supervisor->epollFd, events, SUPERVISOR_EVENTS, timeoutMs);
+
+        for (e=0; e<eventCount; e++) {
+            if (events[e].data.fd == supervisor->signalFd) {
+                // One notification may stand for several children; reapChildren finds them all
+                while (read(supervisor->signalFd, &info, sizeof(info)) == sizeof(info));
+            }
+            else if (events[e].data.fd == inputFd) {
+                inputReady = 1;
+            }
+            // Any other event is a pidfd of an exited child, reaped by reapChildren
+        }
+    }
+
+    if (inputFd != -1) {
+        epoll_ctl(supervisor->epollFd, EPOLL_CTL_DEL, inputFd, NULL);
+    }
+
+    return inputReady;
+}
+
+void throttleSupervisor(Supervisor_t* supervisor, int maxJobs) {
+    struct epoll_event events[SUPERVISOR_EVENTS];
+    struct signalfd_siginfo info;
+
+    while (1) {
+        // Consume pending notifications; reapChildren finds the children anyway
+        while (read(supervisor->signalFd, &info, sizeof(info)) == sizeof(info));
+
+        reapChildren(supervisor);
+        int timeoutMs = killOverdueJobs(supervisor);
+
+        if (supervisor->finishJobs) {
+            finishDoneJobs(supervisor);
+        }
+
+        // Only a full supervisor that frees its slots is waited on
+        if (supervisor->jobCount < maxJobs || !supervisor->finishJobs) {
+            return;
+        }
+
+        fflush(stdout);
+        epoll_wait(supervisor->epollFd, events, SUPERVISOR_EVENTS, timeoutMs);
+    }
+}
+
+void closeSupervisor(Supervisor_t* supervisor) {
+    if (supervisor->epollFd != -1) close(supervisor->epollFd);
+    if (supervisor->signalFd != -1) close(supervisor->signalFd);
+
+    sigprocmask(SIG_SETMASK, &supervisor->oldMask, NULL);
+
+    free(supervisor->jobs);
+    supervisor->jobs = NULL;
+    supervisor->jobCount = 0;
+    supervisor->jobCapacity = 0;
+    supervisor->epollFd = -1;
+    supervisor->signalFd = -1;
+}
+
+static double elapsedSecs(const struct timespec* start, const struct timespec* finish) {
+    return (finish->tv_sec - start->tv_sec) + (finish->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int comparePidSlots(const void* a, const void* b) {
+    pid_t pidA = ((const PidSlot_t*)a)->pid;
+    pid_t pidB = ((const PidSlot_t*)b)->pid;
+
+    return (pidA > pidB) - (pidA < pidB);
+}
+
+int redirFile(const char* redirect, const char * mode, FILE* source) {
+    FILE* redirStatus;
+
+    // Redirect output to a file if specified
+    if (redirect != NULL) {
+        // Open with append permissions to prevent overwriting
+        redirStatus = freopen(redirect, mode, source);
+
+        if (redirStatus == NULL) {
+            // outputRedirect failed
+            printf("Redirecting to %s has failed.\n", redirect);
+            return 0;
+        }
+    }
+
+    return 1;
+}
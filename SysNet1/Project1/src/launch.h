@@ -0,0 +1,322 @@
+/**
+ * File:   launch.h
+ *
+ * launch.h contains the tools myshell uses to start and reap its child
+ * processes. Two launch paths are supported:
+ *
+ * LAUNCH_FORK:  The classic fork-exec. Each child redirects stdin/stdout
+ *               with freopen before execv.
+ * LAUNCH_SPAWN: posix_spawn with file actions for the < and > redirects. On
+ *               Linux, glibc implements posix_spawn with a vfork-style clone,
+ *               so the page tables of a large parent are never copied.
+ *
+ * A command line may join several commands with pipes (see Pipeline_t in
+ * parse.h). For every index, myshell launches one copy of the whole pipeline:
+ * instance i of the first command feeds its own copy of each downstream
+ * command, so results stream between processes without temp files. The pipes
+ * are created with pipe2 and are ordinary blocking pipes, so any stage may
+ * move data with splice or tee.
+ *
+ * In both cases the argument vectors of all n children are built in the
+ * parent in one contiguous arena (see buildArgvArena in parse.h) before any
+ * process is started, so the per-child work is a pointer lookup.
+ *
+ * A command may also be over-decomposed: with an oversplit of k, the work is
+ * cut into n*k slices (instances) of which at most n run at the same time. A
+ * new instance is launched as soon as one finishes, so a slow slice holds up
+ * one of the n workers instead of the whole command. Optionally, myshell
+ * computes the [lo, hi) range of every slice itself (see split.h).
+ *
+ * Every process of a command can be confined to a cgroup v2 group of its own
+ * with CPU, memory and cpuset limits (see cgroup.h). Children are created
+ * inside the group (clone3 with CLONE_INTO_CGROUP, or POSIX_SPAWN_SETCGROUP
+ * where posix_spawn supports it), so they never run outside of it. A child
+ * with a group is forked even in LAUNCH_SPAWN mode when posix_spawn cannot
+ * start it there, and on kernels without CLONE_INTO_CGROUP a forked child
+ * joins the group itself before execve.
+ *
+ * Children are supervised by an event loop (see Supervisor_t) rather than a
+ * blocking wait. Every child gets a pidfd (pidfd_open), which becomes readable
+ * when it exits; an epoll instance watches them together with any input the
+ * caller is waiting for (e.g. the next command on stdin). At most
+ * MAX_SUPERVISOR_PIDFDS are open at once, so a large fan-out cannot run
+ * myshell out of descriptors: the children beyond the cap (and all of them on
+ * kernels without pidfds) are noticed through SIGCHLD, which is blocked and
+ * read from a signalfd in the same epoll instance. Every wake-up reaps all
+ * exited children with wait4(WNOHANG). A
+ * command may have a deadline; when it passes, its remaining processes are
+ * killed. Their pids cannot have been reused, since they are not reaped yet.
+ *
+ * @author Adam Mooers
+ * @author Luke Kledzik
+ * @date 9/18/2016
+ * @info Course COP4634
+ */
+
+#ifndef LAUNCH_H
+#define LAUNCH_H
+
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include "parse.h"
+#include "stats.h"
+#include "split.h"
+#include "cgroup.h"
+
+/**
+ * Launch paths accepted by execCmd(...). See the header of this file.
+ */
+#define LAUNCH_FORK  0
+#define LAUNCH_SPAWN 1
+
+/**
+ * This struct holds the shell options that change how a command is launched.
+ *
+ * launchMode is LAUNCH_FORK or LAUNCH_SPAWN.
+ * printStats prints a table of per-child accounting after each command (see stats.h).
+ * statsCsv is a CSV file the per-child accounting is appended to, or NULL.
+ * splitMode is SPLIT_NONE, SPLIT_EVEN or SPLIT_WEIGHTED (see split.h).
+ * costExponent is the cost exponent used by SPLIT_WEIGHTED.
+ * oversplit is the number of slices per concurrently running instance (at least 1).
+ * cgroup holds the group limits of every command; cgroup.parent is NULL to not use cgroups.
+ * timeoutSecs is the time a command may run before its processes are killed, or 0.
+ */
+struct LAUNCH_OPTIONS {
+    int    launchMode;      /* LAUNCH_FORK or LAUNCH_SPAWN */
+    int    printStats;      /* print the accounting table */
+    const char *statsCsv;   /* accounting CSV file or NULL */
+    int    splitMode;       /* how myshell computes the slices */
+    double costExponent;    /* cost of value x is x^costExponent */
+    int    oversplit;       /* slices per running instance */
+    CgroupLimits_t cgroup;  /* per-command cgroup limits */
+    double timeoutSecs;     /* deadline after launch, 0 for none */
+};
+
+/**
+ * Typedef for the LAUNCH_OPTIONS struct. LaunchOptions_t is now usable instead of struct LAUNCH_OPTIONS.
+ */
+typedef struct LAUNCH_OPTIONS LaunchOptions_t;
+
+/**
+ * Executes the given child process a given number of times with the given arguments.
+ * The command should be properly formatted by the time this stage is reached. The actual
+ * fork-exec occurs at this point, so mal-formatted input could forkbomb to the host OS.
+ * n launches will be attempted, but in the case one fails to launch, the unlaunched processes
+ * will be canceled. execCmd automatically waits for started processes to prevent zombies
+ * (it is launchJob, waitJobs and finishJob in a row).
+ * When all have run, the function returns.
+ *
+ * Each child process recieves the presented arguments in the following manner:
+ *   - child_process m i [child_argument]*
+ *
+ * Note (1): m is the number of slices, n times the oversplit of the options
+ * Note (2): i is the index of the process, starting at zero, ending at m-1
+ * Note (3): at most n instances run at the same time
+ * Note (4): with a split mode, SPLIT_LO_ENV and SPLIT_HI_ENV hold the slice of i
+ * Note (5): downstream pipeline stages receive their arguments exactly as typed
+ *
+ * @param n The number of instances of child_process to run at once (correctly formatted)
+ * @param pipeline original, user-defined, tokenized commands (child_process is the first stage)
+ * @param options how to launch the children and report on them
+ */
+void execCmd(int n, const Pipeline_t* pipeline, const LaunchOptions_t* options);
+
+/**
+ * Attempts to redirect a file to another gracefully. If this fails, an error
+ * is printed to the terminal.
+ *
+ * @param redirect the name of the new file to redirect to
+ * @param mode the mode of the permissions
+ * @param source the file to redirect
+ *
+ * @return: 0 if failure to redirect input or output, !0 otherwise.
+ */
+int redirFile(const char* redirect, const char * mode, FILE* source);
+
+/**
+ * Pairs a pid with the position of its accounting record, so reaped
+ * children can be found by binary search.
+ */
+struct PID_SLOT {
+    pid_t pid;      /* process id */
+    int   slot;     /* position of the record in the job's stats */
+};
+
+/**
+ * Typedef for the PID_SLOT struct. PidSlot_t is now usable instead of struct PID_SLOT.
+ */
+typedef struct PID_SLOT PidSlot_t;
+
+/**
+ * This struct holds one launched command (all instances of its pipeline) from
+ * launch until its children have been reaped and reported.
+ *
+ * pipeline and options are copies of the command and the options it was launched with.
+ * arena holds the argument vectors and output file names of the instances.
+ * stats holds one accounting record per launched process, in launch order.
+ * slots maps the pids of the launched processes to their records, sorted by pid.
+ * slices holds the [lo, hi) range of every index, or is NULL without a split mode.
+ * envp is the environment handed to the first stage when there are slices.
+ * stagesLeft holds the number of unreaped processes of every index.
+ * launchCount and reapCount are the numbers of processes launched and reaped so far.
+ * instanceCount is the number of indexes whose pipeline was (at least partly) launched.
+ * maxRunning is the number of instances that may run at once, runningCount the
+ * number that are running now.
+ * cancelled is set when a launch fails, so no further indexes are started.
+ * cgroup is the group the processes run in (cgroup.path is NULL without one).
+ * pidFds holds the pidfd of every launched process, in launch order, or -1 while it has none.
+ * watchCount is the number of processes (in launch order) a supervisor has considered for a pidfd.
+ * id is the number a supervisor reports the job under (0 until it is supervised).
+ * deadline is the CLOCK_MONOTONIC time the job is killed at, if options.timeoutSecs is set.
+ * timedOut is set once the deadline has passed and the job was killed.
+ */
+struct JOB {
+    Pipeline_t      pipeline;       /* the command being run */
+    LaunchOptions_t options;        /* how it was launched */
+    ArgvArena_t     arena;          /* argument vectors and output names */
+    ChildStat_t     *stats;         /* per-process accounting */
+    PidSlot_t       *slots;         /* pid lookup, sorted by pid */
+    Slice_t         *slices;        /* per-index range or NULL */
+    char            **envp;         /* environment with the slice variables */
+    int             *stagesLeft;    /* unreaped processes per index */
+    int             launchCount;    /* processes launched */
+    int             reapCount;      /* processes reaped */
+    int             instanceCount;  /* indexes launched */
+    int             maxRunning;     /* instances allowed at once */
+    int             runningCount;   /* instances running */
+    int             cancelled;      /* stop launching indexes */
+    Cgroup_t        cgroup;         /* group of the processes */
+    int             *pidFds;        /* per-process pidfd or -1 */
+    int             watchCount;     /* processes given a pidfd or skipped */
+    int             id;             /* supervisor job number */
+    struct timespec deadline;       /* kill time (CLOCK_MONOTONIC) */
+    int             timedOut;       /* killed at the deadline */
+};
+
+/**
+ * Typedef for the JOB struct. Job_t is now usable instead of struct JOB.
+ */
+typedef struct JOB Job_t;
+
+/**
+ * Launches the first instances of a command like execCmd(...), but returns as soon as
+ * they are started. The job must be passed to waitJobs(...), which launches the
+ * remaining instances as running ones finish, and then to finishJob(...).
+ *
+ * @param n The number of instances of child_process to create (correctly formatted)
+ * @param pipeline original, user-defined, tokenized commands (child_process is the first stage)
+ * @param options how to launch the children and report on them
+ * @return the new job, or NULL if it could not be allocated
+ */
+Job_t* launchJob(int n, const Pipeline_t* pipeline, const LaunchOptions_t* options);
+
+/**
+ * Waits for any open child process of the given jobs to finish and accepts their
+ * exit codes. This should be run after launchJob(..) to prevent zombie processes and
+ * the grader's wrath. Each child is reaped with wait4, and its status and resource
+ * usage are stored in the record of the job it belongs to. When an instance of an
+ * over-decomposed job finishes, its next index is launched in its place. Jobs that
+ * pass their deadline are killed. The jobs are not finished.
+ *
+ * @param jobs the jobs to wait for
+ * @param count the number of jobs
+ */
+void waitJobs(Job_t** jobs, int count);
+
+/**
+ * Reports on a job whose children have all been reaped (statistics table, CSV,
+ * merged output and cgroup pressure, as requested by its options) and releases it.
+ *
+ * @param job the job to finish
+ */
+void finishJob(Job_t* job);
+
+/**
+ * The most pidfds a supervisor keeps open at once.
+ */
+#define MAX_SUPERVISOR_PIDFDS 256
+
+/**
+ * This struct holds the event loop that supervises running jobs.
+ *
+ * epollFd watches signalFd, the pidfds of the children and the input passed to runSupervisor(...).
+ * signalFd reports SIGCHLD, which is blocked while the supervisor is open.
+ * pidFdCount is the number of pidfds open, at most MAX_SUPERVISOR_PIDFDS.
+ * oldMask is the signal mask to restore when the supervisor is closed.
+ * jobs holds the supervised jobs, in launch order.
+ * jobCount and jobCapacity are the number of jobs and the room for them.
+ * nextId is the number the next supervised job is reported under.
+ * streamStatus prints a line for every child as it ends and for every finished job.
+ * finishJobs finishes (reports and releases) jobs as soon as all of their children are reaped.
+ */
+struct SUPERVISOR {
+    int      epollFd;       /* event loop */
+    int      signalFd;      /* SIGCHLD notifications */
+    int      pidFdCount;    /* pidfds of children open */
+    sigset_t oldMask;       /* mask before SIGCHLD was blocked */
+    Job_t    **jobs;        /* supervised jobs */
+    int      jobCount;      /* jobs supervised */
+    int      jobCapacity;   /* room in jobs */
+    int      nextId;        /* number of the next job */
+    int      streamStatus;  /* print each child as it ends */
+    int      finishJobs;    /* finish jobs once reaped */
+};
+
+/**
+ * Typedef for the SUPERVISOR struct. Supervisor_t is now usable instead of struct SUPERVISOR.
+ */
+typedef struct SUPERVISOR Supervisor_t;
+
+/**
+ * Blocks SIGCHLD and creates the signalfd and epoll instance of a supervisor.
+ * The pidfds of the children are opened as they are launched.
+ *
+ * @param supervisor the supervisor to open
+ * @param streamStatus print a line for every child as it ends
+ * @param finishJobs finish jobs as soon as all of their children are reaped
+ * @return 1 if successful, 0 otherwise (nothing is left open)
+ */
+int openSupervisor(Supervisor_t* supervisor, int streamStatus, int finishJobs);
+
+/**
+ * Adds a launched job to a supervisor. If the supervisor finishes jobs, it
+ * takes ownership of the job.
+ *
+ * @param supervisor the supervisor
+ * @param job the job, as returned by launchJob(...)
+ * @return 1 if successful, 0 if there is no room for the job
+ */
+int superviseJob(Supervisor_t* supervisor, Job_t* job);
+
+/**
+ * Runs the event loop of a supervisor: reaps children as they end, launches
+ * the next instances of over-decomposed jobs, kills jobs past their deadline
+ * and finishes completed jobs (if the supervisor finishes jobs).
+ *
+ * @param supervisor the supervisor
+ * @param inputFd a descriptor to wait for, or -1 to run until every child is reaped
+ * @return 1 if inputFd became readable, 0 if every child was reaped
+ */
+int runSupervisor(Supervisor_t* supervisor, int inputFd);
+
+/**
+ * Reaps, kills and finishes like runSupervisor(...), but without waiting for
+ * anything while fewer than maxJobs jobs are supervised. Otherwise it waits
+ * until a job has finished (only a supervisor that finishes jobs frees a slot).
+ *
+ * @param supervisor the supervisor
+ * @param maxJobs the number of jobs that may be in flight
+ */
+void throttleSupervisor(Supervisor_t* supervisor, int maxJobs);
+
+/**
+ * Closes the descriptors of a supervisor and restores the signal mask. Jobs
+ * that are still supervised are not waited for.
+ *
+ * @param supervisor the supervisor to close
+ */
+void closeSupervisor(Supervisor_t* supervisor);
+
+#endif
@@ -10,77 +10,162 @@
  * @info Course COP4634
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include "parse.h"
+#include "launch.h"
 
-#define CMD_BUFFER_LEN 500
-#define SHELL_USAGE "Usage: command count [child_argument]*"
+#define SHELL_USAGE "Usage: command count [child_argument]* [| command [argument]*]*"
+#define MYSHELL_USAGE "Usage: myshell [-Debug] [-Spawn] [-Stats] [-Csv file] [-Script file]\n" \
+                      "               [-Overlap] [-Async] [-Jobs k] [-Timeout secs]\n" \
+                      "               [-Split even|weighted [-Cost exponent]] [-Oversplit k]\n" \
+                      "               [-Cgroup dir [-CpuLimit cpus] [-MemoryMax bytes] [-Cpuset list]]"
+
+/*
+ * Lines of a script starting with this character are ignored
+ */
+#define SCRIPT_COMMENT '#'
+
+/*
+ * Commands that may run at the same time in -Overlap or -Async mode, unless
+ * -Jobs says otherwise
+ */
+#define DEFAULT_MAX_JOBS 16
+
+/*
+ * Shell options set from the myshell command line (see main)
+ */
+int debugMode = 0;              // Print the tokenized input (-Debug)
+int overlapMode = 0;            // Overlap independent commands (-Overlap)
+int asyncMode = 0;              // Overlap and stream child status (-Async)
+int maxJobs = DEFAULT_MAX_JOBS; // Commands in flight at once (-Jobs k)
+LaunchOptions_t launchOptions = {
+    LAUNCH_FORK,                // How children are started (-Spawn, see launch.h)
+    0,                          // Print per-child accounting (-Stats, see stats.h)
+    NULL,                       // Append per-child accounting to a CSV (-Csv file)
+    SPLIT_NONE,                 // Compute each child's slice (-Split mode, see split.h)
+    DEFAULT_COST_EXPONENT,      // Cost of a value for -Split weighted (-Cost exponent)
+    1,                          // Slices per running instance (-Oversplit k)
+    {                           // Per-command cgroup (see cgroup.h)
+        NULL,                   // Parent of the groups (-Cgroup dir)
+        0,                      // CPU bandwidth in CPUs (-CpuLimit cpus)
+        NULL,                   // memory.max (-MemoryMax bytes)
+        NULL                    // cpuset.cpus (-Cpuset list)
+    },
+    0                           // Kill a command after this many seconds (-Timeout secs)
+};
+
+/*
+ * Supervises the commands launched in -Overlap or -Async mode that have not
+ * finished yet (only open in those modes)
+ */
+Supervisor_t supervisor;
+int supervising = 0;
+
+/*
+ * The tokenized line; its token and argument storage is reused from line to line
+ */
+Pipeline_t inputPipeline;
+
+/**
+ * Tokenizes, validates and runs one line of input.
+ *
+ * @param line the null-terminated line, without its newline (modified in place)
+ * @param fromScript whether the line comes from a script (blank lines and comments are skipped)
+ * @return 0 if the line is the exit command, !0 otherwise
+ */
+int handleLine(char* line, int fromScript);
+
+/**
+ * Runs every line of a script file back to back, without prompting. The file is
+ * memory-mapped privately and tokenized in place, so there is no limit on the length
+ * of a line and no line is copied. In -Overlap mode, commands are launched without
+ * waiting for the previous ones unless they share a file (see pipelinesConflict).
+ *
+ * @param path the script to run
+ * @return 1 if the script could be read, 0 otherwise
+ */
+int runScript(const char* path);
 
 /**
  * Processes a tokenized shell command. If the input is properly-formatted,
  * the shell will create and manage an arbitrary number of specified child
  * processes. In the case that the input is not correctly formatted, an error
  * message will describe the problem. Input piping (<) and output piping (>)
- * of child processes are supported and optional.
+ * of child processes are supported and optional. An output redirect containing
+ * %i (e.g. >out.%i) gives each instance its own file, and >>file appends those
+ * files to file in index order once every instance has finished.
  * 
  * Command format:
- *   - child_process n [child_argument]*
+ *   - child_process n [child_argument]* [| command [argument]*]*
  *
  * Note(0): * indicates 0 or more of the item in brackets
  * Note(1): child_process indicates the child process to run
  * Note(2): n is an integer which indicates the number of child_process to create
+ * Note(3): each instance of child_process pipes its output into its own copy
+ *          of the downstream commands. Only child_process may redirect its
+ *          input and only the last command may redirect its output.
  *
  * See execCmd(...) for information on how the child processes recieve the formatted
  * information.
  *
  * Note(4): i is the index of the child, in the order that they are executed
+ * Note(5): with -Oversplit k, n*k children are run, at most n at a time
  *
- * @param inputCmd the tokenized input command from myshell. 
+ * @param pipeline the tokenized input commands from myshell. 
  */
-void processCmd(const Param_t* inputCmd);
+void processCmd(const Pipeline_t* pipeline);
 
 /**
- * Executes the given child process a given number of times with the given arguments.
- * The command should be properly formatted by the time this stage is reached. The actual
- * fork-exec occurs at this point, so mal-formatted input could forkbomb to the host OS.
- * n forks will be attempted, but in the case one fails to launch, the unlaunched processes
- * will be canceled. execCmd automatically waits for started processes to prevent zombies.
- * When all have run, the function returns.
+ * Checks that a downstream pipeline stage names a runnable program and does not
+ * redirect a stream that is already connected to a pipe. An error message
+ * is printed if it does not.
  *
- * Each child process recieves the presented arguments in the following manner:
- *   - child_process n i [child_argument]*
- *
- * Note (1): i is the index of the process, starting at zero, ending at n-1
- *
- * @param n The number of instances of child_process to create (correctly formatted)
- * @param inputCmd original, user-defined, tokenized arguments
+ * @param stage the tokenized stage
+ * @param isLast whether the stage is the last in its pipeline
+ * @return 1 if the stage can be launched, 0 otherwise
  */
-void execCmd(int n, const Param_t* inputCmd);
+int validateStage(const Param_t* stage, int isLast);
 
 /**
- * Attempts to redirect a file to another gracefully. If this fails, an error
- * is printed to the terminal.
+ * Launches a validated command. In -Overlap and -Async mode the command is handed
+ * to the supervisor (handleLine has already waited for any it shares a file with).
+ * Otherwise the command runs to completion before this returns.
  *
- * @param redirect the name of the new file to redirect to
- * @param mode the mode of the permissions
- * @param source the file to redirect
+ * @param n the number of instances to run at once
+ * @param pipeline the validated command
+ */
+void runCmd(int n, const Pipeline_t* pipeline);
+
+/**
+ * Waits for every supervised job, reporting on each one as it finishes.
+ */
+void drainJobs();
+
+/**
+ * Determines if two commands must not run at the same time because one of them
+ * writes a file (output or merge redirect) that the other reads or writes. Files
+ * are compared by name, and a per-instance template matches each name it expands to.
  *
- * @return: 0 if failure to redirect input or output, !0 otherwise.
+ * @return !0 if the commands conflict, 0 if they are independent
  */
-int redirFile(const char* redirect, const char * mode, FILE* source);
+int pipelinesConflict(const Pipeline_t* a, const Pipeline_t* b);
 
 /**
- * Waits for any open child process to finish and accepts their exit codes. This should
- * be run after execCmd(..) to prevent zombie processes and the grader's wrath.
+ * Determines if two redirects name the same file: the same name, or, when
+ * both exist, the same device and inode (e.g. out and ./out).
  *
- * @param n The number of child processes that need to be closed
+ * @return !0 if they are the same file, 0 otherwise
  */
-void waitChildren(int n);
+int sameRedirectFile(const char* a, const char* b);
 
 /**
  * The entrance point for the shell. The user is prompted for
@@ -88,7 +173,19 @@ void waitChildren(int n);
  * terminates. Otherwise, they can use the shell to start and manage
  * a arbitrary number of child processes (see attemptExec for command
  * formatting and implementation) The -Debug flag allows the user
- * to view their tokenized input.
+ * to view their tokenized input. The -Spawn flag launches children
+ * with posix_spawn instead of fork-exec. The -Stats flag prints the exit
+ * status, CPU time, memory and wall time of every child after each command,
+ * and -Csv file appends the same records to file. -Script file runs the
+ * commands in file instead of prompting, and -Overlap lets independent
+ * commands run at the same time. -Async does the same, and prints the
+ * status of every child as it ends; the prompt returns while commands
+ * run. At most -Jobs k commands are in flight at once; a command waits
+ * for a slot. -Timeout secs kills any command still running after secs. -Split even|weighted hands every
+ * child its [lo, hi) slice of the values (see split.h), weighted by -Cost,
+ * and -Oversplit k cuts the work into k slices per running child.
+ * -Cgroup dir runs every command in a cgroup of its own below dir, limited
+ * by -CpuLimit, -MemoryMax and -Cpuset, and reports its pressure stalls.
  * 
  * @param argc number of arguments from shell
  * @param argv arguments from the shell (not the same as myshell arguments)
@@ -97,38 +194,274 @@ void waitChildren(int n);
  */
 int main(int argc, char** argv) {
 
-    char command[CMD_BUFFER_LEN];
-    const char delimiters[] = " \t\n";
+    const char* scriptPath = NULL;
+    char* command = NULL;
+    size_t commandCapacity = 0;
+    ssize_t commandLen;
+    int i;
+
+    // Read the shell options
+    for (i=1; i<argc; i++) {
+        if (strcmp(argv[i], "-Debug") == 0) {
+            debugMode = 1;
+        }
+        else if (strcmp(argv[i], "-Spawn") == 0) {
+            launchOptions.launchMode = LAUNCH_SPAWN;
+        }
+        else if (strcmp(argv[i], "-Stats") == 0) {
+            launchOptions.printStats = 1;
+        }
+        else if (strcmp(argv[i], "-Csv") == 0 && i+1 < argc) {
+            launchOptions.statsCsv = argv[++i];
+        }
+        else if (strcmp(argv[i], "-Script") == 0 && i+1 < argc) {
+            scriptPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-Overlap") == 0) {
+            overlapMode = 1;
+        }
+        else if (strcmp(argv[i], "-Async") == 0) {
+            asyncMode = 1;
+        }
+        else if (strcmp(argv[i], "-Jobs") == 0 && i+1 < argc &&
+                 isInt(argv[i+1]) && atoi(argv[i+1]) >= 1) {
+            maxJobs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-Timeout") == 0 && i+1 < argc &&
+                 isNumber(argv[i+1]) && atof(argv[i+1]) > 0) {
+            launchOptions.timeoutSecs = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-Split") == 0 && i+1 < argc &&
+                 (strcmp(argv[i+1], "even") == 0 || strcmp(argv[i+1], "weighted") == 0)) {
+            launchOptions.splitMode = (strcmp(argv[++i], "even") == 0) ? SPLIT_EVEN : SPLIT_WEIGHTED;
+        }
+        else if (strcmp(argv[i], "-Cost") == 0 && i+1 < argc &&
+                 isNumber(argv[i+1]) && atof(argv[i+1]) >= 0) {
+            launchOptions.costExponent = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-Oversplit") == 0 && i+1 < argc &&
+                 isInt(argv[i+1]) && atoi(argv[i+1]) >= 1) {
+            launchOptions.oversplit = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-Cgroup") == 0 && i+1 < argc) {
+            launchOptions.cgroup.parent = argv[++i];
+        }
+        else if (strcmp(argv[i], "-CpuLimit") == 0 && i+1 < argc &&
+                 isNumber(argv[i+1]) && atof(argv[i+1]) > 0) {
+            launchOptions.cgroup.cpuLimit = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-MemoryMax") == 0 && i+1 < argc) {
+            launchOptions.cgroup.memoryMax = argv[++i];
+        }
+        else if (strcmp(argv[i], "-Cpuset") == 0 && i+1 < argc) {
+            launchOptions.cgroup.cpus = argv[++i];
+        }
+        else {
+            printf("myshell: unknown option %s\n%s\n", argv[i], MYSHELL_USAGE);
+            return 1;
+        }
+    }
+
+    // The limits are applied to the group of each command
+    if (launchOptions.cgroup.parent == NULL &&
+        (launchOptions.cgroup.cpuLimit > 0 || launchOptions.cgroup.memoryMax != NULL ||
+         launchOptions.cgroup.cpus != NULL)) {
+        printf("myshell: -CpuLimit, -MemoryMax and -Cpuset require -Cgroup\n%s\n", MYSHELL_USAGE);
+        return 1;
+    }
+
+    // Jobs copy their commands, so they may stay in flight while the next line is read
+    if ((overlapMode || asyncMode) && openSupervisor(&supervisor, asyncMode, 1)) {
+        supervising = 1;
+    }
+
+    if (scriptPath != NULL) {
+        int ok = runScript(scriptPath);
+        freePipeline(&inputPipeline);
+        if (supervising) closeSupervisor(&supervisor);
+        return ok ? 0 : 1;
+    }
+
+    // The supervisor waits for stdin itself, so no line may hide in a stdio buffer
+    if (supervising) {
+        setvbuf(stdin, NULL, _IONBF, 0);
+    }
     
     // Enter the terminal loop
     while(1) {
         printf("$$$ ");
-        fgets(command, CMD_BUFFER_LEN, stdin);
-        
+        fflush(stdout);
+
+        // Keep reaping, reporting and killing children until a command arrives
+        if (supervising) {
+            runSupervisor(&supervisor, STDIN_FILENO);
+        }
+
+        // getline grows the buffer, so long commands are never truncated
+        commandLen = getline(&command, &commandCapacity, stdin);
+
+        if (commandLen == -1) {
+            printf("\n");
+            break; // End of input
+        }
+
+        if (commandLen > 0 && command[commandLen-1] == '\n') {
+            command[commandLen-1] = '\0';
+        }
+
         // Check to see if the exit command is issued
-        if(!strcmp(command, "exit\n")) {
+        if (!handleLine(command, 0)) {
             printf("Program terminated.\n");
             break;
         }
-        
-        Param_t inputCommand;
-        tokenize(command, delimiters, &inputCommand);
-
-        // Check if the debug flag is set
-        if(argc > 1 && strcmp(argv[1], "-Debug") == 0) {
-            // -debug is set, so print arguments
-            printParams(&inputCommand);
-        }
-     
-        // Check if the input is correctly-formatted
-        // Run the command if it is formatted correctly.
-        processCmd(&inputCommand);
+    }
+
+    free(command);
+    freePipeline(&inputPipeline);
+
+    if (supervising) {
+        drainJobs();
+        closeSupervisor(&supervisor);
     }
     
     return 0;
 }
 
-void processCmd(const Param_t* inputCmd) {
+int handleLine(char* line, int fromScript) {
+    const char delimiters[] = " \t\r\n";
+    int i;
+
+    // Check to see if the exit command is issued
+    if (!strcmp(line, "exit")) {
+        return 0;
+    }
+
+    if (fromScript) {
+        // Skip blank lines and comments
+        const char* firstChar = line + strspn(line, delimiters);
+
+        if (*firstChar == '\0' || *firstChar == SCRIPT_COMMENT) {
+            return 1;
+        }
+    }
+
+    switch (tokenizePipeline(line, delimiters, &inputPipeline)) {
+    case TOKENIZE_OK:
+        break;
+    case TOKENIZE_BAD_PIPE:
+        printf("myshell: each \"%s\" must join two commands (at most %d).\n%s\n",
+            PIPE_TOKEN, MAXSTAGES, SHELL_USAGE);
+        return 1;
+    case TOKENIZE_BAD_QUOTE:
+        printf("myshell: unterminated quote or trailing backslash.\n");
+        return 1;
+    default:
+        printf("myshell: unable to allocate the arguments.\n");
+        return 1;
+    }
+
+    // Check if the debug flag is set
+    if(debugMode) {
+        // -debug is set, so print arguments
+        for (i=0; i<inputPipeline.stageCount; i++) {
+            if (inputPipeline.stageCount > 1) {
+                printf("Stage %d:\n", i);
+            }
+            printParams(&inputPipeline.stages[i]);
+        }
+    }
+ 
+    // Reap what has finished so far, and wait for a slot if too many
+    // commands are in flight
+    if (supervising) {
+        throttleSupervisor(&supervisor, maxJobs);
+    }
+
+    // A command that shares a file with an in-flight one has to wait for it,
+    // even before its redirects are validated
+    for (i=0; supervising && i<supervisor.jobCount; i++) {
+        if (pipelinesConflict(&inputPipeline, &supervisor.jobs[i]->pipeline)) {
+            drainJobs();
+            break;
+        }
+    }
+ 
+    // Check if the input is correctly-formatted
+    // Run the command if it is formatted correctly.
+    processCmd(&inputPipeline);
+
+    return 1;
+}
+
+int runScript(const char* path) {
+    struct stat fileInfo;
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1 || fstat(fd, &fileInfo) == -1) {
+        printf("myshell: %s: Not available for reading.\n", path);
+        if (fd != -1) close(fd);
+        return 0;
+    }
+
+    size_t size = fileInfo.st_size;
+
+    if (size == 0) {
+        close(fd);
+        return 1; // Nothing to run
+    }
+
+    // A private mapping lets the tokenizer write null terminators without
+    // copying the file or changing it on disk
+    char* script = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (script == MAP_FAILED) {
+        printf("myshell: %s: Unable to map the script.\n", path);
+        return 0;
+    }
+
+    madvise(script, size, MADV_SEQUENTIAL);
+
+    char* cur = script;
+    char* end = script + size;
+    char* lastLine = NULL; // Copy of a final line with no newline
+
+    while (cur < end) {
+        char* newline = (char*)memchr(cur, '\n', end - cur);
+        char* line = cur;
+
+        if (newline != NULL) {
+            *newline = '\0';
+            cur = newline + 1;
+        }
+        else {
+            // There is no room in the mapping for a terminator
+            lastLine = strndup(cur, end - cur);
+            line = lastLine;
+            cur = end;
+        }
+
+        if (line == NULL || !handleLine(line, 1)) {
+            break;
+        }
+    }
+
+    // Every command of the script has finished before it returns
+    if (supervising) {
+        drainJobs();
+    }
+
+    free(lastLine);
+    munmap(script, size);
+
+    return 1;
+}
+
+void processCmd(const Pipeline_t* pipeline) {
+    const Param_t* inputCmd = &pipeline->stages[0];
+    const Param_t* lastCmd = &pipeline->stages[pipeline->stageCount-1];
+    int k;
+
     // Make sure the minimum number of arguments have been added
     if (inputCmd->argumentCount < 2) {
         printf("myshell: missing operand\n%s\n", SHELL_USAGE);
@@ -159,6 +492,29 @@ void processCmd(const Param_t* inputCmd) {
         return;
     }
     
+    // The slices are cut from the first child_argument
+    if (launchOptions.splitMode != SPLIT_NONE &&
+        (inputCmd->argumentCount < 3 || !isInt(inputCmd->argumentVector[2]) ||
+         atol(inputCmd->argumentVector[2]) < 0)) {
+        printf("myshell: -Split needs a value >= 0 after the count.\n%s\n", SHELL_USAGE);
+        return;
+    }
+
+    // Only the last stage may redirect its output
+    if (pipeline->stageCount > 1 &&
+        (inputCmd->outputRedirect != NULL || inputCmd->mergeRedirect != NULL)) {
+        printf("myshell: only the last command may redirect its output.\n%s\n",
+            SHELL_USAGE);
+        return;
+    }
+
+    // Check the downstream stages
+    for (k=1; k<pipeline->stageCount; k++) {
+        if (!validateStage(&pipeline->stages[k], k == pipeline->stageCount-1)) {
+            return;
+        }
+    }
+
     // Check if input redirect file is valid
     if (inputCmd->inputRedirect != NULL &&
         access(inputCmd->inputRedirect, R_OK) != 0) {
@@ -170,93 +526,130 @@ void processCmd(const Param_t* inputCmd) {
     }
     
     // Check if output redirect matches input redirect
-    if (inputCmd->outputRedirect != NULL &&
+    if (lastCmd->outputRedirect != NULL &&
         inputCmd->inputRedirect != NULL &&
-        strcmp(inputCmd->outputRedirect, inputCmd->inputRedirect) == 0) {
+        (sameRedirectFile(lastCmd->outputRedirect, inputCmd->inputRedirect) ||
+         indexTemplateMatches(lastCmd->outputRedirect, inputCmd->inputRedirect))) {
         // Input and output files match, but should not
         printf("myshell: inputRedirect should not match outputRedirect.\n%s\n", 
             SHELL_USAGE);
         return;
     }
+
+    // The merge appends to its file while the input may still be read
+    if (lastCmd->mergeRedirect != NULL &&
+        inputCmd->inputRedirect != NULL &&
+        sameRedirectFile(lastCmd->mergeRedirect, inputCmd->inputRedirect)) {
+        printf("myshell: inputRedirect should not match the merge redirect.\n%s\n",
+            SHELL_USAGE);
+        return;
+    }
     
+    // Merging needs one output file per instance
+    if (lastCmd->mergeRedirect != NULL && !isIndexTemplate(lastCmd->outputRedirect)) {
+        printf("myshell: >>%s needs an output redirect containing %s.\n%s\n",
+            lastCmd->mergeRedirect, INDEX_PLACEHOLDER, SHELL_USAGE);
+        return;
+    }
+
+    runCmd(n, pipeline);
+}
+
+void runCmd(int n, const Pipeline_t* pipeline) {
+    const Param_t* lastCmd = &pipeline->stages[pipeline->stageCount-1];
+
     // Check if output redirect file already is exists, delete if so
-    if (inputCmd->outputRedirect != NULL &&
-        access(inputCmd->outputRedirect, F_OK) == 0) {
-        remove(inputCmd->outputRedirect);
+    // (per-instance files are replaced when their instance starts)
+    if (lastCmd->outputRedirect != NULL &&
+        !isIndexTemplate(lastCmd->outputRedirect) &&
+        access(lastCmd->outputRedirect, F_OK) == 0) {
+        remove(lastCmd->outputRedirect);
+    }
+
+    if (!supervising) {
+        // Launch the pipeline n times
+        execCmd(n, pipeline, &launchOptions);
+        return;
     }
 
-    // Fork the process n times and exec
-    execCmd(n, inputCmd);
+    Job_t* job = launchJob(n, pipeline, &launchOptions);
+
+    if (job != NULL && !superviseJob(&supervisor, job)) {
+        // Fall back to running the command on its own
+        drainJobs();
+        waitJobs(&job, 1);
+        finishJob(job);
+    }
 }
 
-void execCmd(int n, const Param_t* inputCmd) {
-    int forkCount = 0; // The number of forks that were actually successful.
-    int i;
-    
-    // Fork n times
-    for (i=0; i<n; i++) {
-        pid_t pid = fork();
-        
-        if (pid == -1) {
-            // The current fork failed.
-            printf("Unable to launch the %d\n process. Cancelling queue.", forkCount);
-            break;
-        }
-        
-        if (pid == 0) {
-            // If in child process
-            
-            // Format the user command for the child process
-            // Note the exec frees childArgv
-            char** childArgv = formatChildArgV(inputCmd, i);
-            
-            if (redirFile(inputCmd->inputRedirect, "rb", stdin) &&
-                redirFile(inputCmd->outputRedirect, "a", stdout)) {
-                // Launch the new exec
-                execv(*childArgv, childArgv);
-            }
-            
-            //inputCmd->inputRedirect
-            printf("Exec has failed to launch a new process.\n");
-            
-            // Stop-gap fork bomb stopper, in case of a exec error
-            exit(0);
-        }
-        
-        forkCount++;
+void drainJobs() {
+    runSupervisor(&supervisor, -1);
+}
+
+/**
+ * Compares two redirect file names, either of which may be NULL or a
+ * per-instance template.
+ */
+static int sameFile(const char* a, const char* b) {
+    if (a == NULL || b == NULL) {
+        return 0;
     }
-    
-    // Wait for all successful children to finish before returning
-    waitChildren(forkCount);
+
+    return strcmp(a, b) == 0 || indexTemplateMatches(a, b) || indexTemplateMatches(b, a);
 }
 
-void waitChildren(int n) {
-    int status;
-    int i;
-    
-    // Wait for all n processes to close
-    // Note that the ith index may not match the ith process created
-    // Use ps-axu | grep "Z" in terminal to view potential zombies
-    for (i=0; i<n; i++) {
-        wait(&status);
-        //printf("In Wait: PID = %d\n", pid);
+int sameRedirectFile(const char* a, const char* b) {
+    struct stat infoA, infoB;
+
+    if (strcmp(a, b) == 0) {
+        return 1;
     }
+
+    return stat(a, &infoA) == 0 && stat(b, &infoB) == 0 &&
+           infoA.st_dev == infoB.st_dev && infoA.st_ino == infoB.st_ino;
 }
 
-int redirFile(const char* redirect, const char * mode, FILE* source) {
-    FILE* redirStatus;
-    
-    // Redirect output to a file if specified
-    if (redirect != NULL) {
-        // Open with append permissions to prevent overwriting
-        redirStatus = freopen(redirect, mode, source); 
-        
-        if (redirStatus == NULL) {
-            // outputRedirect failed
-            printf("Redirecting to %s has failed.\n", redirect);
-            return 0;
-        }
+/**
+ * Determines if a command writes a file through its output or merge redirect.
+ */
+static int writesFile(const Pipeline_t* pipeline, const char* name) {
+    const Param_t* last = &pipeline->stages[pipeline->stageCount-1];
+
+    return sameFile(last->outputRedirect, name) || sameFile(last->mergeRedirect, name);
+}
+
+int pipelinesConflict(const Pipeline_t* a, const Pipeline_t* b) {
+    const Param_t* lastA = &a->stages[a->stageCount-1];
+
+    // Anything one command writes must not be touched by the other
+    return writesFile(b, lastA->outputRedirect) || writesFile(b, lastA->mergeRedirect) ||
+           writesFile(a, b->stages[0].inputRedirect) ||
+           writesFile(b, a->stages[0].inputRedirect);
+}
+
+int validateStage(const Param_t* stage, int isLast) {
+    // Check if the program in arg[0] exists
+    if (access(stage->argumentVector[0], X_OK) != 0) {
+        // File does not exist, or user lacks exe permissions
+        printf("myshell: \"%s\" is not a recognized command.\n%s\n", 
+            stage->argumentVector[0], 
+            SHELL_USAGE);
+        return 0;
     }
-    
+
+    // The upstream pipe is the input of every downstream stage
+    if (stage->inputRedirect != NULL) {
+        printf("myshell: only the first command may redirect its input.\n%s\n",
+            SHELL_USAGE);
+        return 0;
+    }
+
+    // The downstream pipe is the output of every stage but the last
+    if (!isLast && (stage->outputRedirect != NULL || stage->mergeRedirect != NULL)) {
+        printf("myshell: only the last command may redirect its output.\n%s\n",
+            SHELL_USAGE);
+        return 0;
+    }
+
     return 1;
 }
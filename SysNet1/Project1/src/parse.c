@@ -10,18 +10,14 @@
  * @info Course COP4634
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
 #include "parse.h"
 
-/*
- * Defines the maximum number of base 10 digits required to represent
- * a 32-bit unsigned integer: MAX = floor(log10(2^32-1))+2
- */
-#define INT_MAX_CHARS 11
-
 /**
  * Prints the contents of the Param_t* that is passed
  *
@@ -34,47 +30,360 @@ void printParams(Param_t *param) {
       (param->inputRedirect != NULL) ? param->inputRedirect:"NULL");
     printf ("OutputRedirect: [%s]\n",
       (param->outputRedirect != NULL) ? param->outputRedirect:"NULL");
+    if (param->mergeRedirect != NULL)
+        printf ("MergeRedirect: [%s]\n", param->mergeRedirect);
     printf ("ArgumentCount: [%d]\n", param->argumentCount);
     for (i = 0; i < param->argumentCount; i++)
            printf("ArgumentVector[%2d]: [%s]\n", i, param->argumentVector[i]);
 }
 
+/*
+ * Number of tokens (or arguments) a span (or argument buffer) starts with
+ */
+#define INITIAL_TOKEN_CAPACITY 32
+
 /**
- * Tokenizes the string of chars the user types into the shell
+ * Makes sure a span can hold at least one more token.
  *
- * @param char[], const char[], Param_t*
- * @return void
+ * @return 1 if successful, 0 if the storage could not grow
+ */
+static int reserveToken(TokenSpan_t *span) {
+    if (span->count < span->capacity) {
+        return 1;
+    }
+
+    int capacity = (span->capacity > 0) ? span->capacity*2 : INITIAL_TOKEN_CAPACITY;
+    Token_t *grown = (Token_t *)realloc(span->tokens, sizeof(Token_t)*capacity);
+
+    if (grown == NULL) {
+        return 0;
+    }
+
+    span->tokens = grown;
+    span->capacity = capacity;
+
+    return 1;
+}
+
+/**
+ * Scans a line into tokens, removing quotes and escapes in place
+ *
+ * @param line the line to scan (modified in place)
+ * @param delimiters the characters separating tokens
+ * @param span the caller's token storage
+ * @return the number of tokens, TOKENIZE_BAD_QUOTE or TOKENIZE_NO_MEMORY
+ */
+int scanTokens(char line[], const char delimiters[], TokenSpan_t *span) {
+    unsigned char isDelimiter[256] = { 0 };
+    char *read = line;
+
+    span->count = 0;
+
+    // A lookup table makes the delimiter test one load per character
+    while (*delimiters != '\0') {
+        isDelimiter[(unsigned char)*delimiters++] = 1;
+    }
+
+    while (1) {
+        // Skip to the start of the next token
+        while (isDelimiter[(unsigned char)*read]) {
+            read++;
+        }
+
+        if (*read == '\0') {
+            return span->count;
+        }
+
+        if (!reserveToken(span)) {
+            return TOKENIZE_NO_MEMORY;
+        }
+
+        Token_t *token = &span->tokens[span->count++];
+
+        // An unquoted pipe is a token of its own
+        if (*read == PIPE_TOKEN[0]) {
+            token->text = NULL;
+            token->length = 0;
+            token->flags = TOKEN_PIPE;
+            read++;
+            continue;
+        }
+
+        // The write position never passes the read position, so the token
+        // can be unquoted and null-terminated without moving the rest of the line
+        char *write = read;
+        char quote = '\0';
+
+        token->text = write;
+        token->flags = (*read == '\'' || *read == '"' || *read == '\\') ? TOKEN_LITERAL : 0;
+
+        while (*read != '\0') {
+            char c = *read;
+
+            if (quote == '\'') {
+                // Everything up to the closing single quote is literal
+                if (c == '\'') quote = '\0';
+                else *write++ = c;
+                read++;
+            }
+            else if (c == '\\') {
+                // An escaped character is literal, in or out of double quotes
+                if (read[1] == '\0') {
+                    return TOKENIZE_BAD_QUOTE;
+                }
+                *write++ = read[1];
+                read += 2;
+            }
+            else if (quote == '"') {
+                if (c == '"') quote = '\0';
+                else *write++ = c;
+                read++;
+            }
+            else if (c == '\'' || c == '"') {
+                quote = c;
+                read++;
+            }
+            else if (isDelimiter[(unsigned char)c] || c == PIPE_TOKEN[0]) {
+                break;
+            }
+            else {
+                *write++ = c;
+                read++;
+            }
+        }
+
+        if (quote != '\0') {
+            return TOKENIZE_BAD_QUOTE;
+        }
+
+        token->length = write - token->text;
+
+        // A pipe right after the token is scanned again as its own token
+        if (*read != '\0' && *read != PIPE_TOKEN[0]) {
+            read++;
+        }
+        else if (*read == PIPE_TOKEN[0] && write == read) {
+            // No room to terminate without losing the pipe; record it now
+            if (!reserveToken(span)) {
+                return TOKENIZE_NO_MEMORY;
+            }
+            token = &span->tokens[span->count++];
+            token->text = NULL;
+            token->length = 0;
+            token->flags = TOKEN_PIPE;
+            read++;
+        }
+
+        *write = '\0';
+    }
+}
+
+/**
+ * Releases the storage of a token span
+ *
+ * @param span the span to release
+ */
+void freeTokenSpan(TokenSpan_t *span) {
+    free(span->tokens);
+    span->tokens = NULL;
+    span->count = 0;
+    span->capacity = 0;
+}
+
+/**
+ * Makes sure a pipeline's argument buffer can hold a number of pointers.
+ *
+ * @return 1 if successful, 0 if the storage could not grow
  */
-void tokenize(char command[], const char delimiters[], Param_t *param) {
+static int reserveArguments(Pipeline_t *pipeline, int needed) {
+    if (needed <= pipeline->argumentCapacity) {
+        return 1;
+    }
+
+    int capacity = (pipeline->argumentCapacity > 0) ? pipeline->argumentCapacity : INITIAL_TOKEN_CAPACITY;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+
+    char **grown = (char **)realloc(pipeline->argumentBuffer, sizeof(char *)*capacity);
+
+    if (grown == NULL) {
+        return 0;
+    }
+
+    pipeline->argumentBuffer = grown;
+    pipeline->argumentCapacity = capacity;
+
+    return 1;
+}
+
+/**
+ * Tokenizes a pipeline of commands the user types into the shell
+ *
+ * @param command the line to tokenize (modified in place)
+ * @param delimiters the characters separating tokens
+ * @param pipeline the pipeline to fill
+ * @return TOKENIZE_OK or one of the TOKENIZE_ error codes
+ */
+int tokenizePipeline(char command[], const char delimiters[], Pipeline_t *pipeline) {
+    int tokenCount = scanTokens(command, delimiters, &pipeline->tokens);
+    int t;
+
+    pipeline->stageCount = 0;
+
+    if (tokenCount < 0) {
+        return tokenCount;
+    }
+
+    // Every token could be an argument, and every stage needs a NULL
+    if (!reserveArguments(pipeline, tokenCount + MAXSTAGES)) {
+        return TOKENIZE_NO_MEMORY;
+    }
+
+    char **nextArgument = pipeline->argumentBuffer;
+    Param_t *param = &pipeline->stages[0];
+    Token_t *token = pipeline->tokens.tokens;
+
     // set the Param_t* to default values before tokenizing
-    param->inputRedirect = NULL;
-    param->outputRedirect = NULL;
-    param->argumentCount = 0;
-
-    char *token = strtok(command, delimiters);
-    
-    while(token != NULL) {
-        if(*token == '<') {
-            token++;
-            
+    memset(param, 0, sizeof(Param_t));
+    param->argumentVector = nextArgument;
+    *nextArgument = NULL;
+    pipeline->stageCount = 1;
+
+    for (t=0; t<tokenCount; t++, token++) {
+        char *text = token->text;
+
+        if (token->flags & TOKEN_PIPE) {
+            // A PIPE_TOKEN needs a command on both sides
+            if (param->argumentCount == 0 || pipeline->stageCount == MAXSTAGES) {
+                return TOKENIZE_BAD_PIPE;
+            }
+
+            // the rest of the line belongs to the next stage
+            nextArgument++; // keep the NULL terminator
+            param = &pipeline->stages[pipeline->stageCount++];
+            memset(param, 0, sizeof(Param_t));
+            param->argumentVector = nextArgument;
+            *nextArgument = NULL;
+        }
+        else if ((token->flags & TOKEN_LITERAL) == 0 && *text == '<') {
             // sets inputRedirect if < is read before argument
-            param->inputRedirect = token;
+            param->inputRedirect = text + 1;
         }
-        else if(*token == '>') {
-            token++;
-
+        else if ((token->flags & TOKEN_LITERAL) == 0 && text[0] == '>' && text[1] == '>') {
+            // sets mergeRedirect if >> is read before argument
+            param->mergeRedirect = text + 2;
+        }
+        else if ((token->flags & TOKEN_LITERAL) == 0 && *text == '>') {
             // sets outputRedirect if > is read before argument
-            param->outputRedirect = token;
+            param->outputRedirect = text + 1;
         }
         else {
             // adds arg to array if not input or output redirect
-            param->argumentVector[param->argumentCount] = token;
-
+            *nextArgument++ = text;
+            *nextArgument = NULL;
             param->argumentCount++;
         }
-        
-        token = strtok(NULL, delimiters); // set token to next delimiter
     }
+
+    // A trailing PIPE_TOKEN leaves the last stage empty
+    if (pipeline->stageCount > 1 && param->argumentCount == 0) {
+        return TOKENIZE_BAD_PIPE;
+    }
+
+    return TOKENIZE_OK;
+}
+
+/**
+ * Copies a string into a buffer.
+ *
+ * @param str the string to copy, or NULL
+ * @param next the position in the buffer, advanced past the copy
+ * @return the copy, or NULL if str is NULL
+ */
+static char* copyString(const char *str, char **next) {
+    if (str == NULL) {
+        return NULL;
+    }
+
+    char *copy = *next;
+    *next = stpcpy(copy, str) + 1;
+
+    return copy;
+}
+
+/**
+ * Copies a pipeline without sharing any of its storage
+ *
+ * @param src the pipeline to copy
+ * @param dest the copy (its previous storage is not released)
+ * @return 1 if successful, 0 otherwise
+ */
+int copyPipeline(const Pipeline_t *src, Pipeline_t *dest) {
+    size_t stringBytes = 0;
+    int pointers = 0;
+    int k, i;
+
+    *dest = *src;
+    memset(&dest->tokens, 0, sizeof(TokenSpan_t));
+    dest->argumentBuffer = NULL;
+    dest->argumentCapacity = 0;
+    dest->stringBuffer = NULL;
+
+    // Size every argument vector (with its NULL) and every string in use
+    for (k=0; k<src->stageCount; k++) {
+        const Param_t *param = &src->stages[k];
+
+        pointers += param->argumentCount + 1;
+        for (i=0; i<param->argumentCount; i++) {
+            stringBytes += strlen(param->argumentVector[i]) + 1;
+        }
+        if (param->inputRedirect != NULL) stringBytes += strlen(param->inputRedirect) + 1;
+        if (param->outputRedirect != NULL) stringBytes += strlen(param->outputRedirect) + 1;
+        if (param->mergeRedirect != NULL) stringBytes += strlen(param->mergeRedirect) + 1;
+    }
+
+    dest->stringBuffer = (char *)malloc(stringBytes + 1);
+
+    if (dest->stringBuffer == NULL || !reserveArguments(dest, pointers)) {
+        freePipeline(dest);
+        return 0;
+    }
+
+    char **nextArgument = dest->argumentBuffer;
+    char *nextString = dest->stringBuffer;
+
+    for (k=0; k<dest->stageCount; k++) {
+        const Param_t *srcParam = &src->stages[k];
+        Param_t *param = &dest->stages[k];
+
+        param->argumentVector = nextArgument;
+        for (i=0; i<param->argumentCount; i++) {
+            *nextArgument++ = copyString(srcParam->argumentVector[i], &nextString);
+        }
+        *nextArgument++ = NULL;
+
+        param->inputRedirect = copyString(srcParam->inputRedirect, &nextString);
+        param->outputRedirect = copyString(srcParam->outputRedirect, &nextString);
+        param->mergeRedirect = copyString(srcParam->mergeRedirect, &nextString);
+    }
+
+    return 1;
+}
+
+/**
+ * Releases the storage of a pipeline
+ *
+ * @param pipeline the pipeline to release
+ */
+void freePipeline(Pipeline_t *pipeline) {
+    freeTokenSpan(&pipeline->tokens);
+    free(pipeline->argumentBuffer);
+    free(pipeline->stringBuffer);
+    pipeline->argumentBuffer = NULL;
+    pipeline->argumentCapacity = 0;
+    pipeline->stringBuffer = NULL;
+    pipeline->stageCount = 0;
 }
 
 /**
@@ -98,36 +407,220 @@ int isInt(const char* str) {
 }
 
 /**
- * Formats the argument vector (argv) for new execv processes. Each new process 
- * has a new index, so this value needs to be computed dynamically.
- *
- * @param inputCmd the validated, tokenized input from myshell. 
- * @param curI the current index of the process (see execCmd description)
- * @return A reference to the newly-concatenated string
- */
-char** formatChildArgV(const Param_t* inputCmd, int curI) {
-    // Allocate memory for the int string (plus the null pointer)
-    char* curIStr = (char*)malloc(INT_MAX_CHARS+1);
-    sprintf(curIStr, "%d", curI);
-    
-    // Allocate memory for the argument vector
-    char** argv = (char **)malloc(sizeof(char*)*inputCmd->argumentCount+2);
-    
-    char** argvPtr = argv;
-    
-    *(argvPtr++) = inputCmd->argumentVector[0]; // filename
-    *(argvPtr++) = inputCmd->argumentVector[1]; // n
-    *(argvPtr++) = curIStr; // Current index i
-    
-    int i;
-    
-    // Retrieve the rest of the argument vectors
-    for(i=2; i<inputCmd->argumentCount;i++) {
-        *(argvPtr++) = inputCmd->argumentVector[i];
-    }
-    
-    // NULL pointer is required to let exec know when argv ends
-    *argvPtr = NULL;
-    
-    return argv;
+ * Determines if a given string is a finite decimal number, such as 2 or 0.5,
+ * optionally signed. Unlike atof(...), anything else is rejected: trailing
+ * characters, exponents, hexadecimal, "inf" and "nan", and numbers too large
+ * to be represented.
+ *
+ * @param str the string to validate
+ * @return whether str can be converted to a finite number
+ */
+int isNumber(const char* str) {
+    const char* digits = str;
+    int digitCount = 0;
+
+    // Account for sign
+    if (*digits == '+' || *digits == '-') digits++;
+
+    while (isdigit((unsigned char)*digits)) {
+        digits++;
+        digitCount++;
+    }
+
+    if (*digits == '.') {
+        digits++;
+        while (isdigit((unsigned char)*digits)) {
+            digits++;
+            digitCount++;
+        }
+    }
+
+    if (digitCount == 0 || *digits != '\0') {
+        return 0;
+    }
+
+    // Hundreds of digits still read as infinity
+    return isfinite(strtod(str, NULL));
+}
+
+/**
+ * Determines if a redirect names one file per instance.
+ *
+ * @param redirect the redirect file name (may be NULL)
+ * @return whether redirect contains INDEX_PLACEHOLDER
+ */
+int isIndexTemplate(const char* redirect) {
+    return redirect != NULL && strstr(redirect, INDEX_PLACEHOLDER) != NULL;
+}
+
+/**
+ * Determines if a file name is one of the names a per-instance template expands to.
+ *
+ * @param outputTemplate the template (may contain INDEX_PLACEHOLDER)
+ * @param name the file name to test
+ * @return whether replacing each placeholder with an index gives name
+ */
+int indexTemplateMatches(const char* outputTemplate, const char* name) {
+    const char* match = strstr(outputTemplate, INDEX_PLACEHOLDER);
+
+    if (match == NULL) {
+        return strcmp(outputTemplate, name) == 0;
+    }
+
+    // The text before the placeholder must match exactly
+    size_t prefixLen = match - outputTemplate;
+    if (strncmp(outputTemplate, name, prefixLen) != 0) {
+        return 0;
+    }
+
+    // The placeholder stands for at least one digit
+    name += prefixLen;
+    if (!isdigit((unsigned char)*name)) {
+        return 0;
+    }
+    while (isdigit((unsigned char)*name)) {
+        name++;
+    }
+
+    return indexTemplateMatches(match + strlen(INDEX_PLACEHOLDER), name);
+}
+
+/**
+ * Copies a file name template, replacing each INDEX_PLACEHOLDER with an index.
+ *
+ * @param dest the buffer to fill (see buildArgvArena for its size)
+ * @param outputTemplate the template to expand
+ * @param curIStr the formatted index
+ * @return a pointer to the character following the null terminator in dest
+ */
+static char* expandIndexTemplate(char* dest, const char* outputTemplate, const char* curIStr) {
+    const char* match;
+
+    while ((match = strstr(outputTemplate, INDEX_PLACEHOLDER)) != NULL) {
+        memcpy(dest, outputTemplate, match - outputTemplate);
+        dest += match - outputTemplate;
+        dest = stpcpy(dest, curIStr);
+        outputTemplate = match + strlen(INDEX_PLACEHOLDER);
+    }
+
+    return stpcpy(dest, outputTemplate) + 1;
+}
+
+/**
+ * Formats the argument vectors (argv) for n new execv processes. Each new process
+ * has a new index, so this value needs to be computed for each one. The count
+ * passed to the children is n, which may differ from the count that was typed
+ * when an instance is split into several slices. Everything is stored in one
+ * allocation laid out as follows:
+ *
+ *   [argv 0]...[argv n-1][output name 0]...[output name n-1]
+ *   [count string][index string 0]...[index string n-1][expanded name 0]...[expanded name n-1]
+ *
+ * The output names are only present when outputTemplate is not NULL.
+ *
+ * @param inputCmd the validated, tokenized input from myshell.
+ * @param outputTemplate a file name containing INDEX_PLACEHOLDER, or NULL
+ * @param n the number of child processes (see execCmd description)
+ * @param arena the arena to fill
+ * @return 1 if successful, 0 if the arena could not be allocated
+ */
+int buildArgvArena(const Param_t* inputCmd, const char* outputTemplate,
+                   int n, ArgvArena_t* arena) {
+    // filename, n, i, the remaining arguments and the NULL pointer
+    int slots = inputCmd->argumentCount+2;
+    size_t argvBytes = sizeof(char*)*slots*n;
+    size_t nameBytes = 0;
+    size_t nameLen = 0;
+
+    if (outputTemplate != NULL) {
+        // Every placeholder may grow into a full index
+        const char* match = outputTemplate;
+        nameLen = strlen(outputTemplate)+1;
+
+        while ((match = strstr(match, INDEX_PLACEHOLDER)) != NULL) {
+            nameLen += INT_MAX_CHARS;
+            match += strlen(INDEX_PLACEHOLDER);
+        }
+
+        nameBytes = (sizeof(char*) + nameLen)*n;
+    }
+
+    arena->count = n;
+    arena->slotsPerArgv = slots;
+    arena->block = (char**)malloc(argvBytes + nameBytes + (size_t)(INT_MAX_CHARS+1)*(n+1));
+
+    if (arena->block == NULL) {
+        return 0;
+    }
+
+    arena->outputNames = (outputTemplate != NULL) ? arena->block + (size_t)slots*n : NULL;
+
+    char* countStr = (char*)arena->block + argvBytes + ((outputTemplate != NULL) ? sizeof(char*)*n : 0);
+    char* curIStr = countStr + INT_MAX_CHARS+1;
+    char* curName = curIStr + (size_t)(INT_MAX_CHARS+1)*n;
+    int curI, i;
+
+    sprintf(countStr, "%d", n);
+
+    for (curI=0; curI<n; curI++) {
+        char** argvPtr = arena->block + (size_t)curI*slots;
+
+        sprintf(curIStr, "%d", curI);
+
+        *(argvPtr++) = inputCmd->argumentVector[0]; // filename
+        *(argvPtr++) = countStr; // n
+        *(argvPtr++) = curIStr; // Current index i
+
+        // Retrieve the rest of the argument vectors
+        for(i=2; i<inputCmd->argumentCount;i++) {
+            *(argvPtr++) = inputCmd->argumentVector[i];
+        }
+
+        // NULL pointer is required to let exec know when argv ends
+        *argvPtr = NULL;
+
+        if (outputTemplate != NULL) {
+            arena->outputNames[curI] = curName;
+            expandIndexTemplate(curName, outputTemplate, curIStr);
+            curName += nameLen;
+        }
+
+        curIStr += INT_MAX_CHARS+1;
+    }
+
+    return 1;
+}
+
+/**
+ * Returns the prebuilt argument vector for a child process.
+ *
+ * @param arena an arena filled by buildArgvArena
+ * @param curI the index of the process, from 0 to arena->count-1
+ * @return the NULL-terminated argument vector for process curI
+ */
+char** childArgV(const ArgvArena_t* arena, int curI) {
+    return arena->block + (size_t)curI*arena->slotsPerArgv;
+}
+
+/**
+ * Returns the expanded output file name for a child process.
+ *
+ * @param arena an arena filled by buildArgvArena
+ * @param curI the index of the process, from 0 to arena->count-1
+ * @return the output file name for process curI, or NULL if there is no template
+ */
+const char* childOutput(const ArgvArena_t* arena, int curI) {
+    return (arena->outputNames != NULL) ? arena->outputNames[curI] : NULL;
+}
+
+/**
+ * Releases the memory held by an arena.
+ *
+ * @param arena an arena filled by buildArgvArena
+ */
+void freeArgvArena(ArgvArena_t* arena) {
+    free(arena->block);
+    arena->block = NULL;
+    arena->outputNames = NULL;
+    arena->count = 0;
 }
@@ -11,23 +11,102 @@
 #define PARSE_H
 
 /**
- * MAXARGS defined to represent the upper bound allowed for arguments read.
+ * MAXSTAGES defined to represent the upper bound allowed for commands in one pipeline.
  */
-#define MAXARGS 32
+#define MAXSTAGES 8
+
+/**
+ * The token that separates the stages of a pipeline. Unless it is quoted, it
+ * does not need to be surrounded by delimiters.
+ */
+#define PIPE_TOKEN "|"
+
+/*
+ * Flags describing a scanned token (see Token_t)
+ */
+#define TOKEN_PIPE    1     /* an unquoted PIPE_TOKEN */
+#define TOKEN_LITERAL 2     /* the first character was quoted or escaped */
+
+/*
+ * Results of tokenizePipeline(...)
+ */
+#define TOKENIZE_OK          1    /* the pipeline is well formed */
+#define TOKENIZE_BAD_PIPE    0    /* a stage is empty or there are too many stages */
+#define TOKENIZE_BAD_QUOTE  -1    /* a quote is not closed or the line ends with a backslash */
+#define TOKENIZE_NO_MEMORY  -2    /* the token or argument storage could not grow */
+
+/**
+ * The placeholder in an output redirect that is replaced with the index of the
+ * instance, e.g. >out.%i writes instance 0 to out.0, instance 1 to out.1, ...
+ */
+#define INDEX_PLACEHOLDER "%i"
+
+/*
+ * Defines the maximum number of base 10 digits required to represent
+ * a 32-bit unsigned integer: MAX = floor(log10(2^32-1))+2
+ */
+#define INT_MAX_CHARS 11
+
+/**
+ * This struct holds one token found by scanTokens(...). The text is a slice of
+ * the scanned line: quotes and escapes have been removed in place and the
+ * slice is null-terminated, so it can be used as a C string.
+ *
+ * text is the first character of the token (NULL for a TOKEN_PIPE).
+ * length is the number of characters in text.
+ * flags is a combination of TOKEN_PIPE and TOKEN_LITERAL.
+ */
+struct TOKEN {
+    char *text;     /* slice of the scanned line */
+    int  length;    /* characters in text */
+    int  flags;     /* TOKEN_PIPE, TOKEN_LITERAL */
+};
+
+/**
+ * Typedef for the TOKEN struct. Token_t is now usable instead of struct TOKEN.
+ */
+typedef struct TOKEN Token_t;
+
+/**
+ * This struct holds the tokens of one line. The storage is owned by the caller
+ * and grows as needed, so a span that is reused from line to line stops
+ * allocating once it has seen the longest line. Zero-initialize it before the
+ * first use and release it with freeTokenSpan(...).
+ *
+ * tokens is the token storage.
+ * count is the number of tokens found in the last scan.
+ * capacity is the number of tokens the storage can hold.
+ */
+struct TOKEN_SPAN {
+    Token_t *tokens;    /* token storage */
+    int     count;      /* tokens in the last scan */
+    int     capacity;   /* tokens the storage can hold */
+};
+
+/**
+ * Typedef for the TOKEN_SPAN struct. TokenSpan_t is now usable instead of struct TOKEN_SPAN.
+ */
+typedef struct TOKEN_SPAN TokenSpan_t;
 
 /**
  * This struct holds the data gathered from stdin after running myshell.
  * 
  * inputRedirect is the location where data is read from if desired.
- * outputRedirect is the location where data is written to if desired.
+ * outputRedirect is the location where data is written to if desired. It may contain
+ * INDEX_PLACEHOLDER to give every instance its own file.
+ * mergeRedirect is the location the per-instance files are appended to, in index order,
+ * after all instances finish (written as >>file). It requires an outputRedirect template.
  * argumentCount is the number of arguments entered.
  * argumentVector is an array holding the arguments entered. The size of the array is stored in argumentCount.
+ * The entry following the last argument is always NULL, so the vector can be handed to execv as-is.
+ * The array is owned by the Pipeline_t the command belongs to.
  */
 struct PARAM {
     char *inputRedirect;           /* file name or NULL */
-    char *outputRedirect;          /* file name or NULL */
+    char *outputRedirect;          /* file name, file name template or NULL */
+    char *mergeRedirect;           /* file name or NULL */
     int  argumentCount;            /* number of tokens in argument vector */
-    char *argumentVector[MAXARGS]; /* array of strings */
+    char **argumentVector;         /* array of strings */
 };
 
 /**
@@ -35,6 +114,35 @@ struct PARAM {
  */
 typedef struct PARAM Param_t;
 
+/**
+ * This struct holds a command line made of one or more commands joined with PIPE_TOKEN.
+ * Zero-initialize it before the first use and release it with freePipeline(...). A
+ * pipeline that is reused from line to line keeps its storage.
+ *
+ * stageCount is the number of commands in the pipeline.
+ * stages holds the commands in order. The standard output of each stage feeds the
+ * standard input of the next. Only the first stage may redirect its input and
+ * only the last stage may redirect its output.
+ * tokens is the storage for the tokens of the line.
+ * argumentBuffer is the storage every stage's argumentVector points into.
+ * argumentCapacity is the number of pointers argumentBuffer can hold.
+ * stringBuffer holds the strings of a copy made by copyPipeline(...), or is NULL
+ * when the strings point into the tokenized line.
+ */
+struct PIPELINE {
+    int         stageCount;            /* number of commands in stages */
+    Param_t     stages[MAXSTAGES];     /* the commands, upstream first */
+    TokenSpan_t tokens;                /* token storage */
+    char        **argumentBuffer;      /* argument vector storage */
+    int         argumentCapacity;      /* pointers in argumentBuffer */
+    char        *stringBuffer;         /* strings of a copy or NULL */
+};
+
+/**
+ * Typedef for the PIPELINE struct. Pipeline_t is now usable instead of struct PIPELINE.
+ */
+typedef struct PIPELINE Pipeline_t;
+
 /**
  * Prints the data currently stored in the Param_t structure.
  * Used when the shell is run in -Debug mode.
@@ -42,11 +150,45 @@ typedef struct PARAM Param_t;
 void printParams(Param_t* param);
 
 /**
- * Breaks down the commands entered within the myshell program.
- * Stores input and output redirects (if included).
- * Stores arguments into an array.
+ * Splits a line into tokens separated by any of the delimiters. The scan is
+ * reentrant (no hidden state) and works in place: the tokens are slices of line.
+ *
+ * Single quotes preserve every character up to the closing quote. Double quotes
+ * preserve every character except a backslash, which escapes the next character.
+ * Outside of quotes, a backslash escapes the next character and an unquoted
+ * PIPE_TOKEN is always a token of its own.
+ *
+ * @return the number of tokens, TOKENIZE_BAD_QUOTE or TOKENIZE_NO_MEMORY
+ */
+int scanTokens(char line[], const char delimiters[], TokenSpan_t *span);
+
+/**
+ * Releases the storage of a token span.
+ */
+void freeTokenSpan(TokenSpan_t *span);
+
+/**
+ * Breaks down a command line made of commands joined with PIPE_TOKEN.
+ * Each command stores its input and output redirects (if included)
+ * and its arguments into its own stage. Redirect tokens are recognized
+ * by their unquoted first character.
+ *
+ * @return TOKENIZE_OK or one of the TOKENIZE_ error codes
+ */
+int tokenizePipeline(char command[], const char delimiters[], Pipeline_t *pipeline);
+
+/**
+ * Copies a pipeline, including its argument vectors and strings, so that the
+ * copy outlives src and the command line src was tokenized from.
+ *
+ * @return 1 if successful, 0 if the argument vectors could not be allocated
+ */
+int copyPipeline(const Pipeline_t *src, Pipeline_t *dest);
+
+/**
+ * Releases the storage of a pipeline.
  */
-void tokenize(char command[], const char delimiters[], Param_t *param);
+void freePipeline(Pipeline_t *pipeline);
 
 /**
  * Determines if a given string can be converted to a valid integer.
@@ -56,9 +198,73 @@ void tokenize(char command[], const char delimiters[], Param_t *param);
 int isInt(const char* str);
 
 /**
- * Formats the argument vector (argv) for new execv processes. Each new process 
- * has a new index, so this value needs to be computed dynamically.
+ * Determines if a given string is a finite decimal number such as 2 or 0.5
+ * (no exponent, hexadecimal, inf or nan).
+ */
+int isNumber(const char* str);
+
+/**
+ * Determines if a redirect names one file per instance, i.e. whether it
+ * contains INDEX_PLACEHOLDER.
+ */
+int isIndexTemplate(const char* redirect);
+
+/**
+ * Determines if a file name is one of the names a per-instance template
+ * expands to, i.e. whether each INDEX_PLACEHOLDER can be replaced with an index to
+ * produce name.
+ */
+int indexTemplateMatches(const char* outputTemplate, const char* name);
+
+/**
+ * Holds the argument vectors (argv) for every child of one launch. All of
+ * the vectors and their index strings live in a single contiguous block that
+ * is filled in by the parent before any process is started, so each child
+ * only needs a pointer lookup (see childArgV). When the output redirect is a
+ * template, the expanded file name of every instance is stored there as well
+ * (see childOutput).
+ *
+ * block is the contiguous allocation holding every vector, name and string.
+ * outputNames points at the expanded output file names within block, or is NULL.
+ * count is the number of argument vectors (one per child index).
+ * slotsPerArgv is the number of pointers in each vector, including the NULL.
+ */
+struct ARGV_ARENA {
+    char **block;       /* argument vectors, output names, then strings */
+    char **outputNames; /* per-index output file names or NULL */
+    int  count;         /* number of argument vectors */
+    int  slotsPerArgv;  /* pointers per vector, including the NULL */
+};
+
+/**
+ * Typedef for the ARGV_ARENA struct. ArgvArena_t is now usable instead of struct ARGV_ARENA.
+ */
+typedef struct ARGV_ARENA ArgvArena_t;
+
+/**
+ * Formats the argument vectors (argv) for n new execv processes. Each new process
+ * has a new index, so every vector differs in its third entry. The second entry
+ * is n itself. The vectors
+ * point into inputCmd, so inputCmd must outlive the arena. If outputTemplate
+ * is not NULL, its expansion for every index is stored too.
+ */
+int buildArgvArena(const Param_t* inputCmd, const char* outputTemplate,
+                   int n, ArgvArena_t* arena);
+
+/**
+ * Returns the prebuilt argument vector for the child with index curI.
+ */
+char** childArgV(const ArgvArena_t* arena, int curI);
+
+/**
+ * Returns the expanded output file name for the child with index curI, or
+ * NULL if the arena was built without an output template.
+ */
+const char* childOutput(const ArgvArena_t* arena, int curI);
+
+/**
+ * Releases the memory held by an arena built with buildArgvArena.
  */
-char** formatChildArgV(const Param_t* inputCmd, int curI);
+void freeArgvArena(ArgvArena_t* arena);
 
 #endif
@@ -0,0 +1,83 @@
+/**
+ * File: prime.c
+ *
+ * prime prints the prime numbers in the range of values of its instance
+ * (see resources/readme.md). Unlike the prebuilt program, it tests the
+ * [lo, hi) slice myshell hands it with -Split instead of its own share of
+ * the values (see split.h).
+ *
+ * Usage: prime <totalNumInstances> <index> <upperValue>
+ *
+ * @author Adam Mooers
+ * @author Luke Kledzik
+ * @date 9/18/2016
+ * @info Course COP4634
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "split.h"
+
+/**
+ * Determines if a value is prime by trial division up to its square root.
+ *
+ * @param value the value to test
+ * @return whether value is prime
+ */
+int isPrime(long value);
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        printf("invalid number of parameters; usage: prime <countInstances> <index> <value>\n");
+        return -1;
+    }
+
+    int count = atoi(argv[1]);
+    int index = atoi(argv[2]);
+    long value = atol(argv[3]);
+    Slice_t slice;
+    long x;
+
+    if (count < 1) {
+        printf("invalid number of instances; value must be greater than zero\n");
+        return -1;
+    }
+    if (index < 0 || index >= count) {
+        printf("invalid index; value must be greater or equal to zero and less the total number of instances\n");
+        return -1;
+    }
+    if (value < 1) {
+        printf("invalid parameter value; value must be greater than zero\n");
+        return -1;
+    }
+
+    // Without a slice, every instance takes an equal share of [0, value)
+    if (!sliceFromEnv(&slice)) {
+        slice.lo = value*index/count;
+        slice.hi = value*(index+1)/count;
+    }
+
+    for (x=slice.lo; x<slice.hi; x++) {
+        if (isPrime(x)) {
+            printf("%ld\n", x);
+        }
+    }
+
+    return 0;
+}
+
+int isPrime(long value) {
+    long d;
+
+    if (value < 2) {
+        return 0;
+    }
+
+    for (d=2; d <= value/d; d++) {
+        if (value % d == 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
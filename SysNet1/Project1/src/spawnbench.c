@@ -0,0 +1,93 @@
+/**
+ * spawnbench.c measures how many child processes per second myshell can
+ * launch and reap with each of its launch paths (see launch.h). For every
+ * count n from 10 to 10000 the same command is run with fork-exec and with
+ * posix_spawn, and the throughput of both is printed to stdout as csv:
+ *
+ *      n, fork procs/sec, spawn procs/sec
+ *
+ * Forking gets slower as the parent grows, so an optional ballast (in MB)
+ * can be allocated and touched first to simulate a large shell.
+ *
+ * Usage: spawnbench [program] [ballast MB]
+ *
+ * @author Adam Mooers
+ * @author Luke Kledzik
+ * @date 9/18/2016
+ * @info Course COP4634
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "parse.h"
+#include "launch.h"
+
+#define DEFAULT_PROGRAM "/bin/true"
+#define MIN_COUNT       10
+#define MAX_COUNT       10000
+#define BYTES_PER_MB    (1024*1024)
+
+/**
+ * Launches and reaps n copies of the command and returns the throughput.
+ *
+ * @param n the number of children to launch
+ * @param pipeline the tokenized command to launch
+ * @param launchMode LAUNCH_FORK or LAUNCH_SPAWN
+ * @return the number of processes launched and reaped per second
+ */
+double procsPerSecond(int n, const Pipeline_t* pipeline, int launchMode) {
+    struct timespec start, finish;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    LaunchOptions_t options = { launchMode, 0, NULL, SPLIT_NONE, DEFAULT_COST_EXPONENT, 1,
+                                { NULL, 0, NULL, NULL }, 0 };
+
+    execCmd(n, pipeline, &options);
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+
+    double secs = (finish.tv_sec - start.tv_sec) +
+                  (finish.tv_nsec - start.tv_nsec) / 1e9;
+
+    return n / secs;
+}
+
+int main(int argc, char** argv) {
+    char program[] = DEFAULT_PROGRAM;
+    char countStr[INT_MAX_CHARS+1];
+    char* args[3] = { (argc > 1) ? argv[1] : program, countStr, NULL };
+    Pipeline_t pipeline;
+    Param_t* cmd = &pipeline.stages[0];
+    int n;
+
+    memset(&pipeline, 0, sizeof(Pipeline_t));
+    pipeline.stageCount = 1;
+    cmd->argumentCount = 2;
+    cmd->argumentVector = args;
+
+    // Make the parent large so fork has page tables to copy
+    if (argc > 2) {
+        size_t ballastLen = (size_t)atoi(argv[2]) * BYTES_PER_MB;
+        char* ballast = (char*)malloc(ballastLen);
+
+        if (ballast == NULL) {
+            fprintf(stderr, "Unable to allocate the ballast.\n");
+            return 1;
+        }
+        memset(ballast, 1, ballastLen);
+    }
+
+    printf("n, fork procs/sec, spawn procs/sec\n");
+
+    for (n = MIN_COUNT; n <= MAX_COUNT; n *= 10) {
+        sprintf(countStr, "%d", n);
+
+        double forkRate = procsPerSecond(n, &pipeline, LAUNCH_FORK);
+        double spawnRate = procsPerSecond(n, &pipeline, LAUNCH_SPAWN);
+
+        printf("%d, %.0f, %.0f\n", n, forkRate, spawnRate);
+    }
+
+    return 0;
+}
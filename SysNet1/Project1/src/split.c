@@ -0,0 +1,71 @@
+/**
+ * File: split.c
+ *
+ * Implements split.h. See split.h for details.
+ *
+ * @author Adam Mooers
+ * @author Luke Kledzik
+ * @date 9/18/2016
+ * @info Course COP4634
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "split.h"
+
+void computeSlices(long first, long last, int count, int mode,
+                   double costExponent, Slice_t* slices) {
+    // The cost of [0, x) grows like x^(exponent+1), so equal shares of
+    // that integral have boundaries at the (exponent+1)th root
+    double power = costExponent + 1;
+    double firstCost = pow((double)first, power);
+    double lastCost = pow((double)last, power);
+    long lo = first;
+    int k;
+
+    for (k=0; k<count; k++) {
+        long hi;
+
+        if (k == count-1) {
+            hi = last; // Rounding must never drop the end of the range
+        }
+        else if (mode == SPLIT_WEIGHTED) {
+            hi = (long)pow(firstCost + (lastCost - firstCost)*(k+1)/count, 1/power);
+        }
+        else {
+            hi = first + (long)((double)(last - first)*(k+1)/count);
+        }
+
+        // Keep the slices adjacent and in order despite rounding
+        if (hi < lo) hi = lo;
+        if (hi > last) hi = last;
+
+        slices[k].lo = lo;
+        slices[k].hi = hi;
+        lo = hi;
+    }
+}
+
+int sliceFromEnv(Slice_t* slice) {
+    const char* loString = getenv(SPLIT_LO_ENV);
+    const char* hiString = getenv(SPLIT_HI_ENV);
+    char* loEnd;
+    char* hiEnd;
+
+    if (loString == NULL || hiString == NULL) {
+        return 0;
+    }
+
+    long lo = strtol(loString, &loEnd, 10);
+    long hi = strtol(hiString, &hiEnd, 10);
+
+    if (loEnd == loString || *loEnd != '\0' || hiEnd == hiString || *hiEnd != '\0' ||
+        lo < 0 || hi < lo) {
+        return 0;
+    }
+
+    slice->lo = lo;
+    slice->hi = hi;
+
+    return 1;
+}
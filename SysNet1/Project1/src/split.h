@@ -0,0 +1,81 @@
+/**
+ * File:   split.h
+ *
+ * split.h holds the work-splitting helper myshell can use instead of letting
+ * every child recompute its own share of the range. The children (prime,
+ * testme) process the values [0, value), where value is the first
+ * child_argument. myshell cuts that range into half-open [lo, hi) slices and
+ * hands slice i to instance i in the environment variables SPLIT_LO_ENV and
+ * SPLIT_HI_ENV. The prebuilt programs in resources only read their argv, so
+ * they ignore the slices; prime.c and testme.c in this directory are versions
+ * of them that process their slice when it is given (see sliceFromEnv).
+ *
+ * SPLIT_EVEN:     Every slice holds the same number of values.
+ * SPLIT_WEIGHTED: Every slice holds the same estimated cost, where testing the
+ *                 value x costs x^exponent (trial division up to the square
+ *                 root of x is exponent 0.5). Slices of large values get narrower.
+ *
+ * @author Adam Mooers
+ * @author Luke Kledzik
+ * @date 9/18/2016
+ * @info Course COP4634
+ */
+
+#ifndef SPLIT_H
+#define SPLIT_H
+
+/**
+ * Splitting modes accepted by computeSlices(...). See the header of this file.
+ */
+#define SPLIT_NONE     0
+#define SPLIT_EVEN     1
+#define SPLIT_WEIGHTED 2
+
+/**
+ * The cost exponent used by SPLIT_WEIGHTED unless another one is given.
+ */
+#define DEFAULT_COST_EXPONENT 0.5
+
+/**
+ * The environment variables that hold the slice of each instance.
+ */
+#define SPLIT_LO_ENV "MYSHELL_LO"
+#define SPLIT_HI_ENV "MYSHELL_HI"
+
+/**
+ * This struct holds one slice of a range, [lo, hi).
+ */
+struct SLICE {
+    long lo;    /* first value of the slice */
+    long hi;    /* one past the last value of the slice */
+};
+
+/**
+ * Typedef for the SLICE struct. Slice_t is now usable instead of struct SLICE.
+ */
+typedef struct SLICE Slice_t;
+
+/**
+ * Cuts the range [first, last) into count adjacent slices. The slices cover the
+ * whole range in order; a slice may be empty when there are more slices than values.
+ *
+ * @param first the first value of the range (at least 0)
+ * @param last one past the last value of the range
+ * @param count the number of slices
+ * @param mode SPLIT_EVEN or SPLIT_WEIGHTED
+ * @param costExponent the exponent of the cost of a value for SPLIT_WEIGHTED
+ * @param slices the count slices to fill
+ */
+void computeSlices(long first, long last, int count, int mode,
+                   double costExponent, Slice_t* slices);
+
+/**
+ * Reads the slice myshell handed to this process from SPLIT_LO_ENV and
+ * SPLIT_HI_ENV.
+ *
+ * @param slice filled with the slice if both variables hold a valid one
+ * @return 1 if slice was filled, 0 if the process was given no slice
+ */
+int sliceFromEnv(Slice_t* slice);
+
+#endif
@@ -0,0 +1,88 @@
+/**
+ * File: stats.c
+ *
+ * Implements stats.h. See stats.h for details.
+ *
+ * @author Adam Mooers
+ * @author Luke Kledzik
+ * @date 9/18/2016
+ * @info Course COP4634
+ */
+
+#include <stdio.h>
+#include <sys/wait.h>
+#include "stats.h"
+
+#define CSV_HEADER "command,index,stage,pid,exit_code,signal,wall_s,user_s,sys_s,max_rss_kb\n"
+
+void formatChildStatus(const ChildStat_t* stat, char* buffer, size_t len) {
+    if (stat->timedOut) {
+        snprintf(buffer, len, "timeout");
+    }
+    else if (WIFSIGNALED(stat->status)) {
+        snprintf(buffer, len, "signal %d", WTERMSIG(stat->status));
+    }
+    else {
+        snprintf(buffer, len, "exit %d", WEXITSTATUS(stat->status));
+    }
+}
+
+void printStatsTable(const ChildStat_t* stats, int count, FILE* out) {
+    double userTotal = 0, sysTotal = 0, wallMax = 0;
+    long rssMax = 0;
+    int failed = 0;
+    char statusStr[32];
+    int i;
+
+    fprintf(out, "%6s %5s %8s %-10s %10s %10s %10s %12s\n",
+        "index", "stage", "pid", "status", "wall(s)", "user(s)", "sys(s)", "maxrss(KB)");
+
+    for (i=0; i<count; i++) {
+        const ChildStat_t* stat = &stats[i];
+
+        formatChildStatus(stat, statusStr, sizeof(statusStr));
+        fprintf(out, "%6d %5d %8d %-10s %10.3f %10.3f %10.3f %12ld\n",
+            stat->index, stat->stage, (int)stat->pid, statusStr,
+            stat->wallSecs, stat->userSecs, stat->sysSecs, stat->maxRssKb);
+
+        userTotal += stat->userSecs;
+        sysTotal += stat->sysSecs;
+        if (stat->wallSecs > wallMax) wallMax = stat->wallSecs;
+        if (stat->maxRssKb > rssMax) rssMax = stat->maxRssKb;
+        if (!WIFEXITED(stat->status) || WEXITSTATUS(stat->status) != 0) failed++;
+    }
+
+    // The slowest child bounds the wall time, CPU time adds up
+    fprintf(out, "%d processes, %d failed: wall %.3fs (slowest), user %.3fs, sys %.3fs, maxrss %ldKB (largest)\n",
+        count, failed, wallMax, userTotal, sysTotal, rssMax);
+}
+
+int appendStatsCsv(const char* path, const char* command, const ChildStat_t* stats, int count) {
+    FILE* csv = fopen(path, "a");
+    int i;
+
+    if (csv == NULL) {
+        printf("Writing statistics to %s has failed.\n", path);
+        return 0;
+    }
+
+    // Only a new file needs the header
+    fseek(csv, 0L, SEEK_END);
+    if (ftell(csv) == 0) {
+        fputs(CSV_HEADER, csv);
+    }
+
+    for (i=0; i<count; i++) {
+        const ChildStat_t* stat = &stats[i];
+
+        fprintf(csv, "%s,%d,%d,%d,%d,%d,%.6f,%.6f,%.6f,%ld\n",
+            command, stat->index, stat->stage, (int)stat->pid,
+            WIFEXITED(stat->status) ? WEXITSTATUS(stat->status) : -1,
+            WIFSIGNALED(stat->status) ? WTERMSIG(stat->status) : 0,
+            stat->wallSecs, stat->userSecs, stat->sysSecs, stat->maxRssKb);
+    }
+
+    fclose(csv);
+
+    return 1;
+}
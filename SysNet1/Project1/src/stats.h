@@ -0,0 +1,86 @@
+/**
+ * File:   stats.h
+ *
+ * stats.h holds the resource accounting myshell collects for every child it
+ * launches. When a child is reaped with wait4, its exit status, user and
+ * system CPU time, maximum resident set size and wall time are recorded. The
+ * records of one command can be printed as a summary table or appended to a
+ * CSV file, so index-partitioned jobs can be profiled without /usr/bin/time.
+ *
+ * @author Adam Mooers
+ * @author Luke Kledzik
+ * @date 9/18/2016
+ * @info Course COP4634
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+
+/**
+ * This struct holds the accounting of one child process.
+ *
+ * pid is the process id (0 until the child is launched).
+ * index is the instance index i the child belongs to.
+ * stage is the position of the child in its pipeline (0 for the indexed command).
+ * status is the wait status reported by wait4.
+ * start is the CLOCK_MONOTONIC time the child was launched.
+ * wallSecs, userSecs and sysSecs are the elapsed, user CPU and system CPU seconds.
+ * maxRssKb is the maximum resident set size in kilobytes.
+ * reaped is set once wait4 has reported the child.
+ * timedOut is set if the child was killed because its command passed its deadline.
+ */
+struct CHILD_STAT {
+    pid_t  pid;             /* process id */
+    int    index;           /* instance index i */
+    int    stage;           /* pipeline stage */
+    int    status;          /* wait status */
+    struct timespec start;  /* launch time (CLOCK_MONOTONIC) */
+    double wallSecs;        /* elapsed seconds */
+    double userSecs;        /* user CPU seconds */
+    double sysSecs;         /* system CPU seconds */
+    long   maxRssKb;        /* maximum resident set size */
+    int    reaped;          /* reported by wait4 */
+    int    timedOut;        /* killed at the deadline */
+};
+
+/**
+ * Typedef for the CHILD_STAT struct. ChildStat_t is now usable instead of struct CHILD_STAT.
+ */
+typedef struct CHILD_STAT ChildStat_t;
+
+/**
+ * Formats how a child ended, e.g. "exit 0", "signal 9" or "timeout".
+ *
+ * @param stat the accounting record of the child
+ * @param buffer the buffer to fill
+ * @param len the size of buffer
+ */
+void formatChildStatus(const ChildStat_t* stat, char* buffer, size_t len);
+
+/**
+ * Prints the accounting of every child of one command as a table, followed
+ * by a line of totals.
+ *
+ * @param stats the accounting records
+ * @param count the number of records
+ * @param out the stream to print to
+ */
+void printStatsTable(const ChildStat_t* stats, int count, FILE* out);
+
+/**
+ * Appends the accounting of every child of one command to a CSV file. A
+ * header row is written first if the file is empty.
+ *
+ * @param path the CSV file to append to (created if needed)
+ * @param command the name of the command the records belong to
+ * @param stats the accounting records
+ * @param count the number of records
+ * @return 1 if successful, 0 otherwise
+ */
+int appendStatsCsv(const char* path, const char* command, const ChildStat_t* stats, int count);
+
+#endif
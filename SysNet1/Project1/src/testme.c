@@ -0,0 +1,54 @@
+/**
+ * File: testme.c
+ *
+ * testme prints the instance, the total number of instances, and the range
+ * of values the instance processes (see resources/readme.md). Unlike the
+ * prebuilt program, it processes the [lo, hi) slice myshell hands it with
+ * -Split instead of its own share of the values (see split.h).
+ *
+ * Usage: testme <totalNumInstances> <index> <value>
+ *
+ * @author Adam Mooers
+ * @author Luke Kledzik
+ * @date 9/18/2016
+ * @info Course COP4634
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "split.h"
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        printf("invalid number of parameters; usage: testme <countInstances> <index> <value>\n");
+        return -1;
+    }
+
+    int count = atoi(argv[1]);
+    int index = atoi(argv[2]);
+    long value = atol(argv[3]);
+    Slice_t slice;
+
+    if (count < 1) {
+        printf("invalid number of instances; value must be greater than zero\n");
+        return -1;
+    }
+    if (index < 0 || index >= count) {
+        printf("invalid index; value must be greater or equal to zero and less the total number of instances\n");
+        return -1;
+    }
+    if (value < 1) {
+        printf("invalid parameter value; value must be greater than zero\n");
+        return -1;
+    }
+
+    // Without a slice, every instance takes an equal share of [0, value)
+    if (!sliceFromEnv(&slice)) {
+        slice.lo = value*index/count;
+        slice.hi = value*(index+1)/count;
+    }
+
+    printf("run %d of %d: processing values %ld through %ld\n", index, count, slice.lo, slice.hi);
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * tokenbench.c measures how many command lines per second myshell can
+ * tokenize. The same lines are split with a plain strtok loop (the way
+ * myshell used to tokenize) and with tokenizePipeline (see parse.h), and the
+ * throughput of both is printed to stdout as csv:
+ *
+ *      arguments, strtok lines/sec, strtok MB/sec, tokenizer lines/sec, tokenizer MB/sec
+ *
+ * Every line is copied into a scratch buffer before it is split, since both
+ * tokenizers write into the line. The copy is timed for both.
+ *
+ * Usage: tokenbench [lines]
+ *
+ * @author Adam Mooers
+ * @author Luke Kledzik
+ * @date 9/18/2016
+ * @info Course COP4634
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "parse.h"
+
+#define DEFAULT_LINES   1000000
+#define MIN_ARGUMENTS   2
+#define MAX_ARGUMENTS   128
+#define DELIMITERS      " \t\r\n"
+#define LINE_CAPACITY   4096
+
+/*
+ * Keeps the compiler from discarding the work of the strtok loop
+ */
+volatile int tokenSink;
+
+/**
+ * Builds a command line with a given number of arguments after the command:
+ * redirects, a quoted argument and a second pipeline stage.
+ *
+ * @param line the buffer to fill
+ * @param arguments the number of plain arguments
+ */
+void buildLine(char* line, int arguments) {
+    char* end = line + sprintf(line, "./testme 16 <input.txt >out.%%i");
+    int i;
+
+    for (i=0; i<arguments; i++) {
+        end += sprintf(end, " arg%d", i);
+    }
+
+    sprintf(end, " 'quoted arg' | ./sort -n");
+}
+
+/**
+ * Splits a line into whitespace separated tokens with strtok, like the
+ * tokenizer myshell used before quoting support.
+ *
+ * @param line the line to split (modified in place)
+ * @return the number of tokens
+ */
+int strtokLine(char* line) {
+    char* tokens[LINE_CAPACITY];
+    int count = 0;
+    char* token = strtok(line, DELIMITERS);
+
+    while (token != NULL) {
+        tokens[count++] = token;
+        token = strtok(NULL, DELIMITERS);
+    }
+
+    tokenSink = (count > 0) ? tokens[count-1][0] : 0;
+
+    return count;
+}
+
+/**
+ * Returns the number of seconds since start.
+ */
+double secondsSince(const struct timespec* start) {
+    struct timespec finish;
+
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+
+    return (finish.tv_sec - start->tv_sec) +
+           (finish.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char** argv) {
+    static char line[LINE_CAPACITY];
+    static char scratch[LINE_CAPACITY];
+    long lines = (argc > 1) ? atol(argv[1]) : DEFAULT_LINES;
+    Pipeline_t pipeline;
+    struct timespec start;
+    int arguments;
+    long i;
+
+    // The pipeline is reused, so its storage only grows during the first lines
+    memset(&pipeline, 0, sizeof(Pipeline_t));
+
+    printf("arguments, strtok lines/sec, strtok MB/sec, tokenizer lines/sec, tokenizer MB/sec\n");
+
+    for (arguments = MIN_ARGUMENTS; arguments <= MAX_ARGUMENTS; arguments *= 4) {
+        buildLine(line, arguments);
+        size_t lineLen = strlen(line) + 1;
+        double mb = (double)lines * lineLen / (1024*1024);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i=0; i<lines; i++) {
+            memcpy(scratch, line, lineLen);
+            strtokLine(scratch);
+        }
+        double strtokSecs = secondsSince(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i=0; i<lines; i++) {
+            memcpy(scratch, line, lineLen);
+            if (tokenizePipeline(scratch, DELIMITERS, &pipeline) != TOKENIZE_OK) {
+                fprintf(stderr, "Unable to tokenize: %s\n", line);
+                return 1;
+            }
+        }
+        double tokenizerSecs = secondsSince(&start);
+
+        printf("%d, %.0f, %.1f, %.0f, %.1f\n", arguments,
+            lines / strtokSecs, mb / strtokSecs,
+            lines / tokenizerSecs, mb / tokenizerSecs);
+    }
+
+    freePipeline(&pipeline);
+
+    return 0;
+}
@@ -28,12 +28,35 @@
 /* output.  For example,                                       */
 /*   ./lizard -d                                               */
 /*                                                             */
+/* Execute with the -s command-line option to run the world as */
+/* a discrete-event simulation on a virtual clock instead of   */
+/* in real time.  -l sets the number of lizards and -w the     */
+/* number of seconds until the world ends.  For example,       */
+/*   ./lizard -s -l 10000 -w 120                               */
+/*                                                             */
+/* Every world parameter can be set with --name value or read  */
+/* from a config file with --config file.  Run with --help for */
+/* the list.  For example,                                     */
+/*   ./lizard --config world.cfg --cats 4                      */
+/*                                                             */
+/* At the end of the world the lizards' round trips, waits and */
+/* driveway use are printed.  --csv file also writes the use   */
+/* of the driveway in every second of the world.               */
+/*                                                             */
+/* Execute with -b to time the crossing counters kept under   */
+/* liz_lock against the atomic counters (--atomic 1), and      */
+/* random() against the per-thread generators.  For example,   */
+/*   ./lizard -b -l 1000                                       */
+/*                                                             */
 /***************************************************************/
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
 #include <pthread.h>
 
 #ifdef __APPLE__
@@ -43,9 +66,57 @@
 #define sem_destroy(a)      semaphore_destroy(mach_task_self(), *((semaphore_t *)a))
 #define sem_post(a)         semaphore_signal(*((semaphore_t *)a))
 #define sem_wait(a)         semaphore_wait(*((semaphore_t *)a))
+#define sem_trywait(a)      semaphore_timedwait(*((semaphore_t *)a), (mach_timespec_t){ 0, 0 })
 #define sem_t               semaphore_t
+
+// Condition variables only time out on the realtime clock
+#define WORLD_SLEEP_CLOCK   CLOCK_REALTIME
+
+// There are no pthread barriers; the benchmarks only use one as a start gate
+typedef struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t all;
+  unsigned count, waiting, round;
+} pthread_barrier_t;
+
+static int pthread_barrier_init(pthread_barrier_t *barrier, const void *attr, unsigned count)
+{
+  (void)attr;
+  barrier->count = count;
+  barrier->waiting = 0;
+  barrier->round = 0;
+  pthread_mutex_init(&barrier->lock, NULL);
+  return pthread_cond_init(&barrier->all, NULL);
+}
+
+static int pthread_barrier_wait(pthread_barrier_t *barrier)
+{
+  unsigned round;
+
+  pthread_mutex_lock(&barrier->lock);
+  round = barrier->round;
+  if (++barrier->waiting == barrier->count)
+    {
+      barrier->waiting = 0;
+      barrier->round++;
+      pthread_cond_broadcast(&barrier->all);
+    }
+  else
+    while (round == barrier->round)
+      pthread_cond_wait(&barrier->all, &barrier->lock);
+  pthread_mutex_unlock(&barrier->lock);
+  return 0;
+}
+
+static int pthread_barrier_destroy(pthread_barrier_t *barrier)
+{
+  pthread_cond_destroy(&barrier->all);
+  return pthread_mutex_destroy(&barrier->lock);
+}
 #else
 #include <semaphore.h>
+#define WORLD_SLEEP_CLOCK   CLOCK_MONOTONIC
 #endif
 
 /*
@@ -62,6 +133,11 @@
  */
 void * lizardThread( void * param );
 void * catThread( void * param );
+void simulateWorld(void);
+void runBenchmarks(void);
+int setWorldParam(const char *name, const char *value);
+int loadConfig(const char *path);
+void printUsage(const char *program);
 
 
 /*
@@ -101,11 +177,6 @@ void * catThread( void * param );
  */
 #define MAX_LIZARD_SLEEP     3
 
-/*
- * Maximum seconds for a cat to sleep
- */
-#define MAX_CAT_SLEEP        3
-
 /*
  * Maximum seconds for a lizard to eat
  */
@@ -116,13 +187,83 @@ void * catThread( void * param );
  */
 #define CROSS_SECONDS        2
 
+/*
+ * Stack size of every thread in KB.  The default of 8 MB per
+ * thread would reserve 80 GB of address space for 10,000 lizards,
+ * while a lizard needs little more than the stack of printf.
+ */
+#define THREAD_STACK_KB      64
+
+/*
+ * In unidirectional mode, the most lizards let onto the driveway in
+ * one direction while lizards wait to cross the other way
+ */
+#define DIRECTION_BATCH      8
+
+/*
+ * In unidirectional mode, seconds lizards may wait to cross one way
+ * before the other direction stops letting lizards in
+ */
+#define DIRECTION_MAX_WAIT   10
+
 
 /*
  * Declare global variables here
  */
-pthread_mutex_t liz_lock, cat_lock; // LK
+pthread_mutex_t liz_lock; // LK
 sem_t driveway; // LK
 
+/*
+ * World parameters that can be changed from the command line
+ * (they start out as the defaults above)
+ */
+int numLizards = NUM_LIZARDS;
+int numCats = NUM_CATS;
+int maxLizardCrossing = MAX_LIZARD_CROSSING;
+int worldEnd = WORLDEND;
+int maxLizardSleep = MAX_LIZARD_SLEEP;
+int maxLizardEat = MAX_LIZARD_EAT;
+int crossSeconds = CROSS_SECONDS;
+int unidirectional = UNIDIRECTIONAL;
+int stackKb = THREAD_STACK_KB;
+int atomicCounters = 0;
+int simulate = 0;
+int benchmark = 0;
+int directionBatch = DIRECTION_BATCH;
+int directionMaxWait = DIRECTION_MAX_WAIT;
+int seed = -1;
+
+/*
+ * The world parameters by name, for the command line (--name value)
+ * and the config file (name = value)
+ */
+typedef struct
+{
+  const char *name;
+  int *value;
+  int minimum;
+  const char *help;
+} WorldParam;
+
+WorldParam worldParams[] =
+  {
+    { "lizards",        &numLizards,        1, "number of lizard threads" },
+    { "cats",           &numCats,           0, "number of cat threads" },
+    { "max-crossing",   &maxLizardCrossing, 1, "lizards crossing at once before the cats notice" },
+    { "world-end",      &worldEnd,          1, "seconds until the world ends" },
+    { "lizard-sleep",   &maxLizardSleep,    0, "maximum seconds for a lizard to sleep" },
+    { "lizard-eat",     &maxLizardEat,      0, "maximum seconds for a lizard to eat" },
+    { "cross-seconds",  &crossSeconds,      0, "seconds it takes to cross the driveway" },
+    { "unidirectional", &unidirectional,    0, "1 to let lizards cross one way at a time" },
+    { "batch",          &directionBatch,    1, "lizards let across one way while the other way waits" },
+    { "max-wait",       &directionMaxWait,  0, "seconds before a waiting direction gets its turn" },
+    { "seed",           &seed,              -1, "seed of the random numbers (-1 for the clock)" },
+    { "stack-kb",       &stackKb,           16, "stack size of every thread in KB" },
+    { "atomic",         &atomicCounters,    0, "1 to keep the crossing counts in one atomic word" }
+  };
+
+#define NUM_WORLD_PARAMS (int)(sizeof(worldParams) / sizeof(worldParams[0]))
+
 /**************************************************/
 /* Please leave these variables alone.  They are  */
 /* used to check the proper functioning of your   */
@@ -132,564 +273,2220 @@ sem_t driveway; // LK
 int numCrossingSago2MonkeyGrass;
 int numCrossingMonkeyGrass2Sago;
 int debug;
-int running;
+_Atomic int running;
 /**************************************************/
 
-
-
-
-
+/*
+ * Every sleep of a lizard is a timed wait on shutdownWake, so the
+ * end of the world cuts it short.  The deadlines are on the
+ * monotonic clock, so setting the system time cannot stretch or
+ * cut a sleep; world_sleep_init() sets the clock of shutdownWake.
+ */
+pthread_mutex_t shutdownLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t shutdownWake;
 
 /*
- * main()
+ * world_sleep_init()
  *
- * Should initialize variables, locks, semaphores, etc.
- * Should start the cat thread and the lizard threads
- * Should block until all threads have terminated
- * Status: Incomplete - Make changes to this code.
+ * Creates shutdownWake with WORLD_SLEEP_CLOCK (the monotonic clock,
+ * where it can be picked), before any thread can sleep on it
+ * input: N/A
+ * output: N/A
  */
-int main(int argc, char **argv)
+void world_sleep_init(void)
 {
-  /*
-   * Declare local variables
-   */
-  int i, j; // LK
-  pthread_t cat[NUM_CATS]; // LK
-  pthread_t lizard[NUM_LIZARDS]; // LK
-
-
-  /*
-   * Check for the debugging flag (-d)
-   */
-  debug = 0;
-  if (argc > 1)
-    if (strncmp(argv[1], "-d", 2) == 0)
-      debug = 1;
-
-
-  /*
-   * Initialize variables
-   */
-  numCrossingSago2MonkeyGrass = 0;
-  numCrossingMonkeyGrass2Sago = 0;
-  running = 1;
-
-
-  /*
-   * Initialize random number generator
-   */
-  srandom( (unsigned int)time(NULL) );
-
-
-  /*
-   * Initialize locks and/or semaphores
-   */
-  
-  //  No more than MAX_LIZARD_CROSSING should attempt to use
-  // the shared resource (the driveway) at a given time
-  sem_init(&driveway, 0, MAX_LIZARD_CROSSING); // LK AM
+  pthread_condattr_t attr;
 
-  /*
-   * Create NUM_LIZARDS lizard threads
-   */
-
-  // Create all of the lizard threads. Note that the mutex lock
-  // slows down the rate at which threads are created, but prevents
-  // naming contention.
-  // LK AM
-  for(i = 0; i < NUM_LIZARDS; i++) {
-    pthread_mutex_lock(&liz_lock);
-    pthread_create(&lizard[i], NULL, lizardThread, (void *)(&i));
-  }
+  pthread_condattr_init(&attr);
+#ifndef __APPLE__
+  pthread_condattr_setclock(&attr, WORLD_SLEEP_CLOCK);
+#endif
+  pthread_cond_init(&shutdownWake, &attr);
+  pthread_condattr_destroy(&attr);
+}
 
-  /*
-   * Create NUM_CATS cat threads
-   */
-   
-  // Create all of the cats. Prevent naming contention like with
-  // the lizard threads. Using a separate lock, cat_lock, allows these 
-  // threads to be created as quickly as possible without the possibility 
-  // of deadlock due to the lizards using their lock for new purposes.
-  // LK AM
-  for(j = 0; j < NUM_CATS; j++) {
-    pthread_mutex_lock(&cat_lock);
-    pthread_create(&cat[j], NULL, catThread, (void *)(&j));
-  }
+/*
+ * world_sleep()
+ *
+ * Sleeps like sleep(), but returns as soon as the world ends
+ * input: seconds
+ * output: 1 if the world is still running, 0 if it ended
+ */
+int world_sleep(int seconds)
+{
+  struct timespec deadline;
+  int waited = 0;
 
+  clock_gettime(WORLD_SLEEP_CLOCK, &deadline);
+  deadline.tv_sec += seconds;
 
-  /*
-   * Now let the world run for a while
-   */
-  sleep( WORLDEND );
+  // Only a wakeup (by end_world() or a spurious one) waits again;
+  // ETIMEDOUT and any error end the sleep
+  pthread_mutex_lock(&shutdownLock);
+  while (running && waited == 0)
+    waited = pthread_cond_timedwait(&shutdownWake, &shutdownLock, &deadline);
+  pthread_mutex_unlock(&shutdownLock);
 
+  return running;
+}
 
-  /*
-   * That's it - the end of the world
-   */
+/*
+ * end_world()
+ *
+ * Ends the world and wakes every sleeping lizard
+ * input: N/A
+ * output: N/A
+ */
+void end_world(void)
+{
+  pthread_mutex_lock(&shutdownLock);
   running = 0;
+  pthread_cond_broadcast(&shutdownWake);
+  pthread_mutex_unlock(&shutdownLock);
+}
 
+/*
+ * The directions a lizard can cross the driveway in
+ */
+#define SAGO_2_MONKEYGRASS   0
+#define MONKEYGRASS_2_SAGO   1
 
-  /*
-   * Wait until all threads terminate
-   */
-
-  for(i = 0; i < NUM_LIZARDS; i++) {
-    pthread_join(lizard[i], NULL);
-  }
-  for(j = 0; j < NUM_CATS; j++) {
-    pthread_join(cat[j], NULL);
-  }
-
-
-
-   /*
-    * Delete the locks and semaphores
-    */
+/*
+ * With --atomic 1 the two counters above are replaced by a single
+ * 64-bit word holding sago -> monkey grass in the low half and
+ * monkey grass -> sago in the high half.  Counting a crossing and
+ * checking the other direction is one fetch-add, and the cats read
+ * both counts with one load, instead of taking liz_lock each time.
+ */
+#define CROSSING_ONE(direction)          (1ULL << ((direction) * 32))
+#define CROSSING_COUNT(word, direction)  (int)(((word) >> ((direction) * 32)) & 0xffffffffULL)
+unsigned long long crossingCounts;
 
-  pthread_mutex_destroy(&liz_lock);
-  pthread_mutex_destroy(&cat_lock);
-  sem_destroy(&driveway);
+/*
+ * The cats do not poll the driveway.  They sleep until a lizard
+ * that starts to cross finds too many lizards on it, or until the
+ * end of the world.  Since the lizard checks the count it just
+ * changed, no crowd goes unnoticed.
+ */
+pthread_mutex_t catWatch = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t catWake = PTHREAD_COND_INITIALIZER;
+int catsHaveToys = 0;     /* lizards crossing when the cats noticed, or 0 */
 
-  /*
-   * Exit happily
-   */
-  return 0;
+/*
+ * cats_watch()
+ *
+ * Wakes the cats if a lizard starting to cross made the driveway
+ * too crowded
+ * input: lizards crossing, counting the new one
+ * output: N/A
+ */
+void cats_watch(int crossing)
+{
+  if (crossing <= maxLizardCrossing)
+    return;
+
+  pthread_mutex_lock(&catWatch);
+  if (!catsHaveToys)
+    catsHaveToys = crossing;
+  pthread_cond_broadcast(&catWake);
+  pthread_mutex_unlock(&catWatch);
 }
 
+/*
+ * Total crossings (both directions) each lizard makes in the
+ * counter benchmark (-b)
+ */
+#define BENCH_CROSSINGS      10000
 
 /*
- * These prototypes are declared here so that main()
- * can't use them directly.  Functions and variables
- * must be declared before they can be used.  Using them
- * below this point is fine.
+ * Random numbers each lizard draws in the random number benchmark
  */
+#define BENCH_DRAWS          100000
 
-void lizard_sleep(int num);
-void cat_sleep(int num);
-void sago_2_monkeyGrass_is_safe(int num);
-void cross_sago_2_monkeyGrass(int num);
-void made_it_2_monkeyGrass(int num);
-void lizard_eat(int num);
-void monkeyGrass_2_sago_is_safe(int num);
-void cross_monkeyGrass_2_sago(int num);
-void made_it_2_sago(int num);
+/*
+ * Every thread draws its sleeping and eating times from its own
+ * xoshiro256** generator.  random() would serialize all of them
+ * on a lock inside the C library.  Thread k of a run with seed s
+ * always gets the same numbers, so --seed makes runs repeatable
+ * (as far as the thread scheduling allows).
+ */
+typedef struct
+{
+  uint64_t s[4];
+} LizardRng;
 
+__thread LizardRng threadRng;
 
 /*
- * lizardThread()
+ * rng_seed()
  *
- * Follows the algorithm provided in the assignment
- * description to simulate lizards crossing back and forth
- * between a sago palm and some monkey grass.  
- * input: lizard number
+ * Seeds a generator for one thread, by running splitmix64 on the
+ * seed and the thread number
+ * input: generator, seed, thread number
  * output: N/A
- * Status: Incomplete - Make changes as you see are necessary.
  */
-void * lizardThread( void * param )
+void rng_seed(LizardRng *rng, uint64_t seed, uint64_t thread)
 {
-  int num = *(int*)param;
-  pthread_mutex_unlock(&liz_lock);
+  uint64_t x = seed ^ (thread * 0xd1342543de82ef95ULL);
+  int i;
 
-  if (debug)
+  for (i = 0; i < 4; i++)
     {
-      printf("[%2d] lizard is alive\n", num);
-      fflush(stdout);
-    }
+      uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
 
-  while(running)
-    {
-      /* 
-       * Follow the algorithm given in the assignment
-       * using calls to the functions declared above.
-       * You'll need to complete the implementation of
-       * some functions by filling in the code.  Some  
-       * are already completed - see the comments.
-       */
-      lizard_sleep(num); // LK
-      sago_2_monkeyGrass_is_safe(num); // LK
-      cross_sago_2_monkeyGrass(num); // LK
-      made_it_2_monkeyGrass(num); // LK
-      lizard_eat(num); // LK
-      monkeyGrass_2_sago_is_safe(num); // LK
-      cross_monkeyGrass_2_sago(num); // LK
-      made_it_2_sago(num); // LK
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      rng->s[i] = z ^ (z >> 31);
     }
-
-  pthread_exit(NULL);
 }
 
 /*
- * catThread()
+ * rng_next()
  *
- * This simulates a cat that is sleeping and occasionally checking on
- * the driveway on lizards.
- * 
- * input: cat number
- * output: N/A
- * Status: Incomplete - Make changes as you see are necessary.
+ * input: generator
+ * output: the next 64 random bits (xoshiro256**)
  */
-void * catThread( void * param )
+uint64_t rng_next(LizardRng *rng)
 {
-  int num = *(int*)param;
-  pthread_mutex_unlock(&cat_lock);
-  if (debug)
-    {
-      printf("[%2d] cat is alive\n", num);
-      fflush(stdout);
-    }
-
-  while(running)
-    {
-	  cat_sleep(num);
-      
-	  // The counters are a shared resource. Lock them until they are read.
-      pthread_mutex_lock(&liz_lock); // LK AM
-
-	  /*
-	   * Check for too many lizards crossing
-	   */
-	  if (numCrossingSago2MonkeyGrass + numCrossingMonkeyGrass2Sago > MAX_LIZARD_CROSSING)
-	    {
-		  printf( "\tThe cats are happy - they have toys.\n" );
-		  exit( -1 );
-	    }
-      
-	  // The program did not exit, so free the lock
-	  pthread_mutex_unlock(&liz_lock); // LK AM
-    }
+  uint64_t *s = rng->s;
+  uint64_t result = s[1] * 5;
+  uint64_t t = s[1] << 17;
+
+  result = ((result << 7) | (result >> 57)) * 9;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = (s[3] << 45) | (s[3] >> 19);
+
+  return result;
+}
 
-  pthread_exit(NULL);
+/*
+ * random_seconds()
+ *
+ * Draws a time from the calling thread's generator
+ * input: maximum seconds
+ * output: 1 to max seconds
+ */
+int random_seconds(int max)
+{
+  // The top 53 bits make a double in [0, 1)
+  return 1 + (int)((rng_next(&threadRng) >> 11) * (1.0 / 9007199254740992.0) * max);
 }
 
+/*
+ * What one lizard did during the world.  Every lizard writes only
+ * its own entry, so no lock is needed, and the entries are cache
+ * line aligned so that neighbours do not slow each other down.
+ * main() merges them once the threads are joined.
+ */
+typedef struct
+{
+  long roundTrips;
+  long crossings;
+  double waitSeconds;         /* from wanting to cross to crossing */
+  double maxWaitSeconds;
+  double crossingSeconds;     /* from crossing to made it */
+  int seriesLength;           /* seconds of the world with room in the series */
+  int seriesUsed;             /* seconds up to the last crossing */
+  long *seriesCrossings;      /* crossings finished in every second */
+  double *seriesBusy;         /* seconds on the driveway in every second */
+} __attribute__((aligned(64))) LizardStats;
+
+LizardStats *lizardStats;
+double worldStart;
+const char *csvPath = NULL;
 
 /*
- * lizard_sleep()
+ * stats_grow()
  *
- * Simulate a lizard sleeping for a random amount of time
- * input: lizard number
- * output: N/A
- * Status: Completed - No need to change any of this code.
+ * Makes room in a lizard's series for one more second of the world
+ * input: lizard statistics, second
+ * output: 1 if the second fits, 0 if out of memory
  */
-void lizard_sleep(int num)
+int stats_grow(LizardStats *stats, int second)
 {
-  int sleepSeconds;
+  int length = stats->seriesLength;
 
-  sleepSeconds = 1 + (int)(random() / (double)RAND_MAX * MAX_LIZARD_SLEEP);
+  if (second < length)
+    return 1;
 
-  if (debug)
-    {
-      printf( "[%2d] sleeping for %d seconds\n", num, sleepSeconds );
-      fflush( stdout );
-    }
+  while (length <= second)
+    length = (length > 0) ? length * 2 : worldEnd + 1;
 
-  sleep( sleepSeconds );
+  long *crossings = realloc(stats->seriesCrossings, sizeof(long) * length);
+  if (crossings == NULL)
+    return 0;
+  stats->seriesCrossings = crossings;
 
-  if (debug)
-    {
-      printf( "[%2d] awake\n", num );
-      fflush( stdout );
-    }
+  double *busy = realloc(stats->seriesBusy, sizeof(double) * length);
+  if (busy == NULL)
+    return 0;
+  stats->seriesBusy = busy;
+
+  memset(crossings + stats->seriesLength, 0, sizeof(long) * (length - stats->seriesLength));
+  memset(busy + stats->seriesLength, 0, sizeof(double) * (length - stats->seriesLength));
+  stats->seriesLength = length;
+  return 1;
 }
 
 /*
- * cat_sleep()
+ * stats_crossing()
  *
- * Simulate a cat sleeping for a random amount of time
- * input: cat number
+ * Records one crossing of a lizard
+ * input: lizard statistics, when it wanted to cross, started to
+ *        cross and made it (world_now() times)
  * output: N/A
- * Status: Completed - No need to change any of this code.
  */
-void cat_sleep(int num)
+void stats_crossing(LizardStats *stats, double wanted, double started, double finished)
 {
-  int sleepSeconds;
-
-  sleepSeconds = 1 + (int)(random() / (double)RAND_MAX * MAX_CAT_SLEEP);
-
-  if (debug)
+  double from = started - worldStart;
+  double to = finished - worldStart;
+  int second;
+
+  stats->crossings++;
+  stats->waitSeconds += started - wanted;
+  stats->crossingSeconds += finished - started;
+  if (started - wanted > stats->maxWaitSeconds)
+    stats->maxWaitSeconds = started - wanted;
+
+  if (!stats_grow(stats, (int)to))
+    return;
+
+  // Spread the time on the driveway over the seconds it covers
+  stats->seriesCrossings[(int)to]++;
+  stats->seriesUsed = (int)to + 1;
+  for (second = (int)from; second <= (int)to; second++)
     {
-      printf( "[%2d] cat sleeping for %d seconds\n", num, sleepSeconds );
-      fflush( stdout );
-    }
-
-  sleep( sleepSeconds );
+      double begin = (from > second) ? from : second;
+      double end = (to < second + 1) ? to : second + 1;
 
-  if (debug)
-    {
-      printf( "[%2d] cat awake\n", num );
-      fflush( stdout );
+      stats->seriesBusy[second] += end - begin;
     }
 }
 
- 
 /*
- * sago_2_monkeyGrass_is_safe()
+ * print_stats()
  *
- * Returns when it is safe for this lizard to cross from the sago
- * to the monkey grass.   Should use some synchronization 
- * facilities (lock/semaphore) here.
- * input: lizard number
+ * Merges the statistics of every lizard, prints a summary (and
+ * every lizard with -d) and writes the time series to csvPath
+ * input: seconds the world ran
  * output: N/A
- * Status: Incomplete - Make changes as you see are necessary.
  */
-void sago_2_monkeyGrass_is_safe(int num)
+void print_stats(double seconds)
 {
-  if (debug)
+  long roundTrips = 0, crossings = 0;
+  long fewestTrips = -1, mostTrips = 0;
+  double waitSeconds = 0, maxWaitSeconds = 0, crossingSeconds = 0;
+  int length = 0;
+  int i, second;
+
+  for (i = 0; i < numLizards; i++)
     {
-      printf( "[%2d] checking  sago -> monkey grass\n", num );
-      fflush( stdout );
+      LizardStats *stats = &lizardStats[i];
+
+      roundTrips += stats->roundTrips;
+      crossings += stats->crossings;
+      waitSeconds += stats->waitSeconds;
+      crossingSeconds += stats->crossingSeconds;
+      if (stats->maxWaitSeconds > maxWaitSeconds)
+        maxWaitSeconds = stats->maxWaitSeconds;
+      if (fewestTrips < 0 || stats->roundTrips < fewestTrips)
+        fewestTrips = stats->roundTrips;
+      if (stats->roundTrips > mostTrips)
+        mostTrips = stats->roundTrips;
+      if (stats->seriesUsed > length)
+        length = stats->seriesUsed;
+
+      if (debug)
+        printf("[%2d] %ld round trips, %ld crossings, waited %.1f s (worst %.1f s), crossed %.1f s\n",
+               i, stats->roundTrips, stats->crossings, stats->waitSeconds,
+               stats->maxWaitSeconds, stats->crossingSeconds);
     }
 
-  // Wait until there is an opening to cross the road
-  sem_wait(&driveway); // LK AM
+  printf("%ld round trips (%ld to %ld per lizard), %ld crossings in %.1f s\n",
+         roundTrips, fewestTrips, mostTrips, crossings, seconds);
+  printf("Driveway wait: mean %.2f s, worst %.2f s; crossing: mean %.2f s\n",
+         crossings ? waitSeconds / crossings : 0, maxWaitSeconds,
+         crossings ? crossingSeconds / crossings : 0);
+  printf("Driveway utilization: %.1f%% of %d places\n",
+         100.0 * crossingSeconds / (maxLizardCrossing * seconds), maxLizardCrossing);
+
+  if (csvPath == NULL)
+    return;
+
+  FILE *csv = fopen(csvPath, "w");
+  if (csv == NULL)
+    {
+      printf("Unable to write %s\n", csvPath);
+      return;
+    }
+
+  fprintf(csv, "second,crossings,busy_seconds,utilization\n");
+  for (second = 0; second < length; second++)
+    {
+      long secondCrossings = 0;
+      double busy = 0;
+
+      for (i = 0; i < numLizards; i++)
+        if (second < lizardStats[i].seriesUsed)
+          {
+            secondCrossings += lizardStats[i].seriesCrossings[second];
+            busy += lizardStats[i].seriesBusy[second];
+          }
+
+      fprintf(csv, "%d,%ld,%.3f,%.3f\n", second, secondCrossings, busy, busy / maxLizardCrossing);
+    }
+
+  fclose(csv);
+}
+
+/*
+ * world_now()
+ *
+ * input: N/A
+ * output: the time of the threaded world in seconds (monotonic)
+ */
+double world_now(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * In unidirectional mode the driveway is shared like a readers/
+ * writers lock with two kinds of readers: any number of lizards
+ * (up to the driveway semaphore) may cross the same way together,
+ * but never both ways.  While lizards wait on the other side, at
+ * most directionBatch more are let in, and none once the other
+ * side has waited directionMaxWait seconds.  When the driveway
+ * empties with both sides waiting, the direction changes, so
+ * neither side starves.  The same rules run the threaded and the
+ * simulated world; only the clock differs.
+ */
+typedef struct
+{
+  int direction;            /* direction of the lizards on the driveway, or of the last ones */
+  int active;               /* lizards on the driveway */
+  int admitted;             /* lizards let in since the other side started waiting */
+  int waiting[2];           /* lizards waiting for their direction */
+  double waitingSince[2];   /* when the oldest of them started waiting (roughly) */
+  long crossings[2];
+  double maxWait[2];        /* worst wait from wanting to cross to crossing */
+} DirectionState;
+
+/*
+ * The direction lock of the threaded world
+ */
+typedef struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t turn;
+  DirectionState state;
+} DirectionLock;
+
+DirectionLock crossingTurns = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, { 0 } };
+
+/*
+ * direction_may_enter()
+ *
+ * input: direction state, direction of a waiting lizard, the time
+ * output: 1 if the lizard may start to cross now
+ */
+int direction_may_enter(const DirectionState *state, int direction, double now)
+{
+  int other = !direction;
+
+  // An empty driveway goes to whoever waits, taking turns if both do
+  if (state->active == 0)
+    return state->waiting[other] == 0 || state->direction != direction;
+
+  if (state->direction != direction)
+    return 0;
+
+  // Join the lizards crossing, unless the other side has had enough
+  return state->waiting[other] == 0 ||
+         (state->admitted < directionBatch && now - state->waitingSince[other] < directionMaxWait);
+}
+
+/*
+ * direction_wait()
+ *
+ * A lizard starts waiting to cross in a direction
+ * input: direction state, direction, the time
+ * output: N/A
+ */
+void direction_wait(DirectionState *state, int direction, double now)
+{
+  if (state->waiting[direction]++ == 0)
+    {
+      state->waitingSince[direction] = now;
+
+      // The batch of the lizards crossing the other way starts now
+      if (state->direction != direction)
+        state->admitted = 0;
+    }
+}
+
+/*
+ * direction_enter()
+ *
+ * A waiting lizard that direction_may_enter() let in starts to cross
+ * input: direction state, direction, the time
+ * output: N/A
+ */
+void direction_enter(DirectionState *state, int direction, double now)
+{
+  state->waiting[direction]--;
+
+  if (state->direction != direction)
+    {
+      // The lizards left waiting are about to cross in this batch
+      state->direction = direction;
+      state->admitted = 0;
+      state->waitingSince[direction] = now;
+    }
+
+  state->active++;
+  state->admitted++;
+}
+
+/*
+ * direction_record()
+ *
+ * Adds a crossing to the crossings and the worst wait of its direction
+ * input: direction state, direction, seconds from wanting to cross to crossing
+ * output: N/A
+ */
+void direction_record(DirectionState *state, int direction, double waited)
+{
+  state->crossings[direction]++;
+  if (waited > state->maxWait[direction])
+    state->maxWait[direction] = waited;
+}
+
+/*
+ * direction_lock()
+ *
+ * Blocks until a lizard holding the driveway semaphore may cross
+ * in its direction
+ * input: direction lock, direction
+ * output: N/A
+ */
+void direction_lock(DirectionLock *turns, int direction)
+{
+  pthread_mutex_lock(&turns->lock);
+  direction_wait(&turns->state, direction, world_now());
+
+  while (!direction_may_enter(&turns->state, direction, world_now()))
+    pthread_cond_wait(&turns->turn, &turns->lock);
+
+  int changed = turns->state.direction != direction;
+
+  direction_enter(&turns->state, direction, world_now());
+
+  // Lizards held back while the driveway was empty may now follow
+  if (changed)
+    pthread_cond_broadcast(&turns->turn);
+
+  pthread_mutex_unlock(&turns->lock);
+}
+
+/*
+ * direction_unlock()
+ *
+ * A lizard has made it across
+ * input: direction lock
+ * output: N/A
+ */
+void direction_unlock(DirectionLock *turns)
+{
+  pthread_mutex_lock(&turns->lock);
+  turns->state.active--;
+  if (turns->state.active == 0)
+    pthread_cond_broadcast(&turns->turn);
+  pthread_mutex_unlock(&turns->lock);
+}
+
+/*
+ * direction_count()
+ *
+ * Records a finished crossing, like stats_crossing()
+ * input: direction lock, direction, seconds from wanting to cross to crossing
+ * output: N/A
+ */
+void direction_count(DirectionLock *turns, int direction, double waited)
+{
+  pthread_mutex_lock(&turns->lock);
+  direction_record(&turns->state, direction, waited);
+  pthread_mutex_unlock(&turns->lock);
+}
+
+/*
+ * print_directions()
+ *
+ * Reports the throughput and the worst wait of each direction
+ * input: direction state, seconds the world ran
+ * output: N/A
+ */
+void print_directions(const DirectionState *state, double seconds)
+{
+  printf("sago -> monkey grass: %ld crossings (%.2f/s), worst wait %.1f s\n",
+         state->crossings[SAGO_2_MONKEYGRASS], state->crossings[SAGO_2_MONKEYGRASS] / seconds,
+         state->maxWait[SAGO_2_MONKEYGRASS]);
+  printf("monkey grass -> sago: %ld crossings (%.2f/s), worst wait %.1f s\n",
+         state->crossings[MONKEYGRASS_2_SAGO], state->crossings[MONKEYGRASS_2_SAGO] / seconds,
+         state->maxWait[MONKEYGRASS_2_SAGO]);
+}
+
+
+/*
+ * Build with -DPROFILE_LOCKS=1 (make profile) to measure how long
+ * threads wait for liz_lock and the driveway.  Built without it,
+ * LOCK()/UNLOCK()/SEM_WAIT()/SEM_POST() are the plain calls.
+ */
+#ifndef PROFILE_LOCKS
+#define PROFILE_LOCKS        0
+#endif
+
+#if PROFILE_LOCKS
+
+/*
+ * Latency histograms have one bucket per power of two nanoseconds,
+ * so the last bucket starts at about 34 seconds
+ */
+#define PROFILE_BUCKETS      36
+
+/*
+ * What is known about one lock or semaphore.  Every field is
+ * updated with atomic adds, since the semaphore has several
+ * holders at once.
+ */
+typedef struct
+{
+  const char *name;
+  long acquisitions;
+  long contended;                    /* had to block to acquire */
+  long long waitNs, maxWaitNs;
+  long long holdNs, maxHoldNs;
+  long waitHistogram[PROFILE_BUCKETS];
+  long long lockedAt;                /* mutex only: when it was taken */
+} LockProfile;
+
+LockProfile liz_lock_profile = { "liz_lock" };
+LockProfile driveway_profile = { "driveway" };
+
+/*
+ * A lizard holds at most one driveway slot, so it remembers when
+ * it got it here
+ */
+__thread long long drivewayTakenAt;
+
+#define LOCK(m)     profiled_lock(&m, &m##_profile)
+#define UNLOCK(m)   profiled_unlock(&m, &m##_profile)
+#define SEM_WAIT(s) profiled_sem_wait(&s, &s##_profile)
+#define SEM_POST(s) profiled_sem_post(&s, &s##_profile)
+
+/*
+ * profile_now()
+ *
+ * input: N/A
+ * output: monotonic time in nanoseconds
+ */
+long long profile_now(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/*
+ * profile_max()
+ *
+ * Raises *max to value if it is larger, without a lock
+ * input: maximum to update, new value
+ * output: N/A
+ */
+void profile_max(long long *max, long long value)
+{
+  long long seen = __atomic_load_n(max, __ATOMIC_RELAXED);
+
+  while (value > seen &&
+         !__atomic_compare_exchange_n(max, &seen, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+/*
+ * profile_acquired()
+ *
+ * Records one acquisition that started at start
+ * input: profile, start time, whether the caller had to block
+ * output: time of the acquisition
+ */
+long long profile_acquired(LockProfile *profile, long long start, int blocked)
+{
+  long long now = profile_now();
+  long long waitNs = now - start;
+  int bucket = 0;
+
+  while (bucket < PROFILE_BUCKETS - 1 && (waitNs >> (bucket + 1)) > 0)
+    bucket++;
+
+  __atomic_fetch_add(&profile->acquisitions, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&profile->contended, blocked, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&profile->waitNs, waitNs, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&profile->waitHistogram[bucket], 1, __ATOMIC_RELAXED);
+  profile_max(&profile->maxWaitNs, waitNs);
+  return now;
+}
+
+/*
+ * profile_released()
+ *
+ * Records how long a lock or semaphore slot was held
+ * input: profile, time it was acquired
+ * output: N/A
+ */
+void profile_released(LockProfile *profile, long long takenAt)
+{
+  long long holdNs = profile_now() - takenAt;
+
+  __atomic_fetch_add(&profile->holdNs, holdNs, __ATOMIC_RELAXED);
+  profile_max(&profile->maxHoldNs, holdNs);
+}
+
+/*
+ * profiled_lock(), profiled_unlock(), profiled_sem_wait(), profiled_sem_post()
+ *
+ * The lock and semaphore calls with their waits and holds recorded.
+ * A try comes first so that blocking can be told apart from luck.
+ * input: lock or semaphore, its profile
+ * output: N/A
+ */
+void profiled_lock(pthread_mutex_t *lock, LockProfile *profile)
+{
+  long long start = profile_now();
+  int blocked = 0;
+
+  if (pthread_mutex_trylock(lock) != 0)
+    {
+      blocked = 1;
+      pthread_mutex_lock(lock);
+    }
+
+  profile->lockedAt = profile_acquired(profile, start, blocked);
+}
+
+void profiled_unlock(pthread_mutex_t *lock, LockProfile *profile)
+{
+  // Only the thread holding the mutex releases it, so lockedAt is its own
+  profile_released(profile, profile->lockedAt);
+  pthread_mutex_unlock(lock);
+}
+
+void profiled_sem_wait(sem_t *sem, LockProfile *profile)
+{
+  long long start = profile_now();
+  int blocked = 0;
+
+  if (sem_trywait(sem) != 0)
+    {
+      blocked = 1;
+      sem_wait(sem);
+    }
+
+  drivewayTakenAt = profile_acquired(profile, start, blocked);
+}
+
+void profiled_sem_post(sem_t *sem, LockProfile *profile)
+{
+  profile_released(profile, drivewayTakenAt);
+  sem_post(sem);
+}
+
+/*
+ * print_lock_profile()
+ *
+ * Prints the counts, wait and hold times and the wait histogram
+ * of one lock or semaphore
+ * input: profile
+ * output: N/A
+ */
+void print_lock_profile(const LockProfile *profile)
+{
+  int i;
+  long count = profile->acquisitions > 0 ? profile->acquisitions : 1;
+
+  printf("%s: %ld acquisitions, %ld contended (%.1f%%)\n",
+         profile->name, profile->acquisitions, profile->contended,
+         100.0 * profile->contended / count);
+  printf("  wait  mean %.3f ms  max %.3f ms\n",
+         profile->waitNs / 1e6 / count, profile->maxWaitNs / 1e6);
+  printf("  hold  mean %.3f ms  max %.3f ms\n",
+         profile->holdNs / 1e6 / count, profile->maxHoldNs / 1e6);
+
+  for (i = 0; i < PROFILE_BUCKETS; i++)
+    if (profile->waitHistogram[i] > 0)
+      printf("  wait >= %12.3f us: %ld\n", (i == 0 ? 0 : 1LL << i) / 1e3, profile->waitHistogram[i]);
+}
+
+/*
+ * print_lock_profiles()
+ *
+ * Prints the profile of every lock and semaphore at the end of the world
+ * input: N/A
+ * output: N/A
+ */
+void print_lock_profiles(void)
+{
+  printf("Lock profile:\n");
+  print_lock_profile(&liz_lock_profile);
+  print_lock_profile(&driveway_profile);
+}
+
+#else
+
+#define LOCK(m)     pthread_mutex_lock(&m)
+#define UNLOCK(m)   pthread_mutex_unlock(&m)
+#define SEM_WAIT(s) sem_wait(&s)
+#define SEM_POST(s) sem_post(&s)
+
+#endif
+
+
+
+
+
+
+/*
+ * main()
+ *
+ * Should initialize variables, locks, semaphores, etc.
+ * Should start the cat thread and the lizard threads
+ * Should block until all threads have terminated
+ * Status: Incomplete - Make changes to this code.
+ */
+int main(int argc, char **argv)
+{
+  /*
+   * Declare local variables
+   */
+  int i, j; // LK
+  int numLizardThreads, numCatThreads;
+  pthread_t *cat; // LK
+  pthread_t *lizard; // LK
+  int *threadNums;
+  pthread_attr_t attr;
+
+
+  /*
+   * Check for the debugging flag (-d), the simulation flag (-s)
+   * and the world parameters.  Parameters are applied in order,
+   * so options after --config override the config file.
+   */
+  debug = 0;
+  for (i = 1; i < argc; i++)
+    {
+      if (strncmp(argv[i], "-d", 2) == 0)
+        debug = 1;
+      else if (strcmp(argv[i], "-s") == 0)
+        simulate = 1;
+      else if (strcmp(argv[i], "-b") == 0)
+        benchmark = 1;
+      else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+        {
+          if (!setWorldParam("lizards", argv[++i]))
+            return 1;
+        }
+      else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+        {
+          if (!setWorldParam("world-end", argv[++i]))
+            return 1;
+        }
+      else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+        csvPath = argv[++i];
+      else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc)
+        {
+          if (!loadConfig(argv[++i]))
+            return 1;
+        }
+      else if (strncmp(argv[i], "--", 2) == 0 && strchr(argv[i], '=') != NULL)
+        {
+          // --name=value
+          char name[64];
+          const char *equals = strchr(argv[i], '=');
+
+          snprintf(name, sizeof(name), "%.*s", (int)(equals - argv[i] - 2), argv[i] + 2);
+          if (!setWorldParam(name, equals + 1))
+            return 1;
+        }
+      else if (strncmp(argv[i], "--", 2) == 0 && i + 1 < argc)
+        {
+          // --name value
+          if (!setWorldParam(argv[i] + 2, argv[i + 1]))
+            return 1;
+          i++;
+        }
+      else
+        {
+          printUsage(argv[0]);
+          return 1;
+        }
+    }
+
+
+  /*
+   * Initialize variables
+   */
+  numCrossingSago2MonkeyGrass = 0;
+  numCrossingMonkeyGrass2Sago = 0;
+  crossingCounts = 0;
+  running = 1;
+  world_sleep_init();
+
+
+  /*
+   * Initialize random number generators.  Every thread seeds its
+   * own; the main thread's runs the simulated world.
+   */
+  if (seed < 0)
+    seed = (int)(time(NULL) & 0x3fffffff);
+  if (debug)
+    printf("Seed %d\n", seed);
+  srandom( (unsigned int)seed );
+  rng_seed(&threadRng, seed, numLizards + numCats);
+
+
+  /*
+   * The simulated world needs no threads, locks or semaphores
+   */
+  if (simulate)
+    {
+      simulateWorld();
+      return 0;
+    }
+
+  /*
+   * Neither does the counter benchmark
+   */
+  if (benchmark)
+    {
+      runBenchmarks();
+      return 0;
+    }
+
+
+  /*
+   * Initialize locks and/or semaphores
+   */
+  
+  //  No more than maxLizardCrossing should attempt to use
+  // the shared resource (the driveway) at a given time
+  sem_init(&driveway, 0, maxLizardCrossing); // LK AM
+
+  /*
+   * The thread tables live on the heap so they can hold any number
+   * of threads, and every thread gets a small stack
+   */
+  lizard = malloc(sizeof(pthread_t) * numLizards);
+  cat = malloc(sizeof(pthread_t) * (numCats > 0 ? numCats : 1));
+  threadNums = malloc(sizeof(int) * (numLizards + numCats));
+  lizardStats = aligned_alloc(64, sizeof(LizardStats) * numLizards);
+  if (lizard == NULL || cat == NULL || threadNums == NULL || lizardStats == NULL)
+    {
+      printf("Unable to allocate the thread tables.\n");
+      return 1;
+    }
+
+  memset(lizardStats, 0, sizeof(LizardStats) * numLizards);
+  worldStart = world_now();
+
+  pthread_attr_init(&attr);
+  if (pthread_attr_setstacksize(&attr, (size_t)stackKb * 1024) != 0)
+    printf("Unable to use a %d KB stack, using the default.\n", stackKb);
+
+  /*
+   * Create numLizards lizard threads
+   */
+
+  // Create all of the lizard threads. Every thread gets its own
+  // copy of its number, since i moves on before the new thread may
+  // read it, so no lock is needed to hand it over.
+  // LK AM
+  for(i = 0; i < numLizards; i++) {
+    threadNums[i] = i;
+    if (pthread_create(&lizard[i], &attr, lizardThread, (void *)(&threadNums[i])) != 0) {
+      // The world goes on with the lizards that could be created
+      printf("Unable to create lizard %d, running with %d lizards.\n", i, i);
+      break;
+    }
+  }
+  numLizardThreads = i;
+
+  /*
+   * Create numCats cat threads
+   */
+   
+  // Create all of the cats, numbered like the lizard threads.
+  // LK AM
+  for(j = 0; j < numCats; j++) {
+    threadNums[numLizards + j] = j;
+    if (pthread_create(&cat[j], &attr, catThread, (void *)(&threadNums[numLizards + j])) != 0) {
+      printf("Unable to create cat %d, running with %d cats.\n", j, j);
+      break;
+    }
+  }
+  numCatThreads = j;
+
+  pthread_attr_destroy(&attr);
+
+
+  /*
+   * Now let the world run for a while
+   */
+  world_sleep( worldEnd );
+
+
+  /*
+   * That's it - the end of the world.  Lizards that are out finish
+   * their round trip without sleeping, so this takes milliseconds.
+   */
+  end_world();
+
+  // Wake the cats so they can go home
+  pthread_mutex_lock(&catWatch);
+  pthread_cond_broadcast(&catWake);
+  pthread_mutex_unlock(&catWatch);
+
+
+  /*
+   * Wait until all threads terminate
+   */
+
+  for(i = 0; i < numLizardThreads; i++) {
+    pthread_join(lizard[i], NULL);
+  }
+  for(j = 0; j < numCatThreads; j++) {
+    pthread_join(cat[j], NULL);
+  }
+
+  free(lizard);
+  free(cat);
+  free(threadNums);
+
+#if PROFILE_LOCKS
+  print_lock_profiles();
+#endif
+
+  print_stats(world_now() - worldStart);
+  if (unidirectional)
+    print_directions(&crossingTurns.state, world_now() - worldStart);
+
+  for (i = 0; i < numLizards; i++)
+    {
+      free(lizardStats[i].seriesCrossings);
+      free(lizardStats[i].seriesBusy);
+    }
+  free(lizardStats);
+
+
+
+   /*
+    * Delete the locks and semaphores
+    */
+
+  pthread_mutex_destroy(&liz_lock);
+  sem_destroy(&driveway);
+
+  /*
+   * Exit happily
+   */
+  return 0;
+}
+
+
+/*
+ * setWorldParam()
+ *
+ * Sets a world parameter by name
+ * input: parameter name (e.g. lizards), value as text
+ * output: 1 if the parameter was set, 0 (after printing why) otherwise
+ */
+int setWorldParam(const char *name, const char *value)
+{
+  int i;
+  char *end;
+
+  for (i = 0; i < NUM_WORLD_PARAMS; i++)
+    {
+      if (strcmp(worldParams[i].name, name) != 0)
+        continue;
+
+      long parsed = strtol(value, &end, 10);
+
+      if (end == value || *end != '\0' || parsed < worldParams[i].minimum || parsed > 1000000000L)
+        {
+          printf("%s must be an integer >= %d, not \"%s\"\n", name, worldParams[i].minimum, value);
+          return 0;
+        }
+
+      *worldParams[i].value = (int)parsed;
+      return 1;
+    }
+
+  printf("Unknown parameter \"%s\"\n", name);
+  return 0;
+}
+
+/*
+ * loadConfig()
+ *
+ * Reads world parameters from a file with one "name = value" per
+ * line.  Blank lines and lines starting with # are ignored.
+ * input: path of the config file
+ * output: 1 if every line was applied, 0 otherwise
+ */
+int loadConfig(const char *path)
+{
+  FILE *config = fopen(path, "r");
+  char line[256];
+  char name[64], value[64];
+  int lineNum = 0;
+
+  if (config == NULL)
+    {
+      printf("Unable to open the config file %s\n", path);
+      return 0;
+    }
+
+  while (fgets(line, sizeof(line), config) != NULL)
+    {
+      char *text = line + strspn(line, " \t");
+      lineNum++;
+
+      if (*text == '#' || *text == '\n' || *text == '\0')
+        continue;
+
+      // name = value, or name value
+      if (sscanf(text, "%63[^= \t] = %63s", name, value) != 2 &&
+          sscanf(text, "%63s %63s", name, value) != 2)
+        {
+          printf("%s:%d: expected name = value\n", path, lineNum);
+          fclose(config);
+          return 0;
+        }
+
+      if (!setWorldParam(name, value))
+        {
+          printf("%s:%d: parameter not set\n", path, lineNum);
+          fclose(config);
+          return 0;
+        }
+    }
+
+  fclose(config);
+  return 1;
+}
+
+/*
+ * printUsage()
+ *
+ * Lists the command-line options and world parameters
+ * input: program name
+ * output: N/A
+ */
+void printUsage(const char *program)
+{
+  int i;
+
+  printf("Usage: %s [-d] [-s] [-b] [-l lizards] [-w seconds] [--config file] [--csv file] [--name value]...\n", program);
+  printf("World parameters (also valid as \"name = value\" lines in a config file):\n");
+  for (i = 0; i < NUM_WORLD_PARAMS; i++)
+    printf("  --%-15s %s (%d)\n", worldParams[i].name, worldParams[i].help, *worldParams[i].value);
+}
+
+
+/*
+ * These prototypes are declared here so that main()
+ * can't use them directly.  Functions and variables
+ * must be declared before they can be used.  Using them
+ * below this point is fine.
+ */
+
+void lizard_sleep(int num);
+void sago_2_monkeyGrass_is_safe(int num);
+void cross_sago_2_monkeyGrass(int num);
+void made_it_2_monkeyGrass(int num);
+void lizard_eat(int num);
+void monkeyGrass_2_sago_is_safe(int num);
+void cross_monkeyGrass_2_sago(int num);
+void made_it_2_sago(int num);
+void atomic_crossing_started(int direction);
+
+
+/*
+ * lizardThread()
+ *
+ * Follows the algorithm provided in the assignment
+ * description to simulate lizards crossing back and forth
+ * between a sago palm and some monkey grass.  
+ * input: lizard number
+ * output: N/A
+ * Status: Incomplete - Make changes as you see are necessary.
+ */
+void * lizardThread( void * param )
+{
+  int num = *(int*)param;
+  LizardStats *stats;
+  double wanted, started;
+  rng_seed(&threadRng, seed, num);
+  stats = &lizardStats[num];
+
+  if (debug)
+    {
+      printf("[%2d] lizard is alive\n", num);
+      fflush(stdout);
+    }
+
+  while(running)
+    {
+      /* 
+       * Follow the algorithm given in the assignment
+       * using calls to the functions declared above.
+       * You'll need to complete the implementation of
+       * some functions by filling in the code.  Some  
+       * are already completed - see the comments.
+       */
+      lizard_sleep(num); // LK
+
+      // A lizard that wakes up after the end of the world stays home
+      if (!running)
+        break;
+
+      wanted = world_now();
+      sago_2_monkeyGrass_is_safe(num); // LK
+      started = world_now();
+      cross_sago_2_monkeyGrass(num); // LK
+      made_it_2_monkeyGrass(num); // LK
+
+      // Crossings cut short by the end of the world are not recorded
+      if (running)
+        {
+          stats_crossing(stats, wanted, started, world_now());
+          if (unidirectional)
+            direction_count(&crossingTurns, SAGO_2_MONKEYGRASS, started - wanted);
+        }
+      lizard_eat(num); // LK
+      wanted = world_now();
+      monkeyGrass_2_sago_is_safe(num); // LK
+      started = world_now();
+      cross_monkeyGrass_2_sago(num); // LK
+      made_it_2_sago(num); // LK
+      if (running)
+        {
+          stats_crossing(stats, wanted, started, world_now());
+          if (unidirectional)
+            direction_count(&crossingTurns, MONKEYGRASS_2_SAGO, started - wanted);
+          stats->roundTrips++;
+        }
+    }
+
+  pthread_exit(NULL);
+}
+
+/*
+ * catThread()
+ *
+ * This simulates a cat that is sleeping until cats_watch() wakes it
+ * because there are too many lizards on the driveway.
+ * 
+ * input: cat number
+ * output: N/A
+ * Status: Incomplete - Make changes as you see are necessary.
+ */
+void * catThread( void * param )
+{
+  int num = *(int*)param;
+  if (debug)
+    {
+      printf("[%2d] cat is alive\n", num);
+      fflush(stdout);
+    }
+
+  /*
+   * Sleep until there are too many lizards crossing
+   */
+  pthread_mutex_lock(&catWatch);
+  while (running && !catsHaveToys)
+    pthread_cond_wait(&catWake, &catWatch);
+
+  if (catsHaveToys)
+    {
+      printf( "\tThe cats are happy - they have toys.\n" );
+      printf( "\t%d lizards crossing\n", catsHaveToys );
+      exit( -1 );
+    }
+
+  pthread_mutex_unlock(&catWatch);
+
+  pthread_exit(NULL);
+}
+
+
+/*
+ * lizard_sleep()
+ *
+ * Simulate a lizard sleeping for a random amount of time
+ * input: lizard number
+ * output: N/A
+ * Status: Completed - No need to change any of this code.
+ */
+void lizard_sleep(int num)
+{
+  int sleepSeconds;
+
+  sleepSeconds = random_seconds(maxLizardSleep);
+
+  if (debug)
+    {
+      printf( "[%2d] sleeping for %d seconds\n", num, sleepSeconds );
+      fflush( stdout );
+    }
+
+  world_sleep( sleepSeconds );
+
+  if (debug)
+    {
+      printf( "[%2d] awake\n", num );
+      fflush( stdout );
+    }
+}
+
+/*
+ * sago_2_monkeyGrass_is_safe()
+ *
+ * Returns when it is safe for this lizard to cross from the sago
+ * to the monkey grass.   Should use some synchronization 
+ * facilities (lock/semaphore) here.
+ * input: lizard number
+ * output: N/A
+ * Status: Incomplete - Make changes as you see are necessary.
+ */
+void sago_2_monkeyGrass_is_safe(int num)
+{
+  if (debug)
+    {
+      printf( "[%2d] checking  sago -> monkey grass\n", num );
+      fflush( stdout );
+    }
+
+  // Wait until there is an opening to cross the road
+  SEM_WAIT(driveway); // LK AM
+
+  // And, in unidirectional mode, until it is this direction's turn
+  if (unidirectional)
+    direction_lock(&crossingTurns, SAGO_2_MONKEYGRASS);
+
+  if (debug)
+    {
+      printf( "[%2d] thinks  sago -> monkey grass  is safe\n", num );
+      fflush( stdout );
+    }
+}
+
+
+/*
+ * cross_sago_2_monkeyGrass()
+ *
+ * Delays for 1 second to simulate crossing from the sago to
+ * the monkey grass. 
+ * input: lizard number
+ * output: N/A
+ * Status: Incomplete - Make changes as you see are necessary.
+ */
+void cross_sago_2_monkeyGrass(int num)
+{
+  if (debug)
+    {
+      printf( "[%2d] crossing  sago -> monkey grass\n", num );
+      fflush( stdout );
+    }
+
+  /*
+   * One more crossing this way, then check for lizards crossing
+   * both ways.  The atomic counters do both in one step.
+   */
+  if (atomicCounters)
+    atomic_crossing_started(SAGO_2_MONKEYGRASS);
+  else
+    {
+      // There is a shared counter here. Lock and access it.
+      LOCK(liz_lock); // LK AM
+      numCrossingSago2MonkeyGrass++;
+      cats_watch(numCrossingSago2MonkeyGrass + numCrossingMonkeyGrass2Sago);
+
+      if (debug)
+        {
+          printf("Lizards crossing: %d\n", numCrossingSago2MonkeyGrass+numCrossingMonkeyGrass2Sago); // LK AM
+        }
+
+      UNLOCK(liz_lock); // LK AM
+
+      // There is a shared counter in the if statement. Lock and access it.
+      LOCK(liz_lock); // LK AM
+
+      if (numCrossingMonkeyGrass2Sago && unidirectional)
+        {
+          printf( "\tCrash!  We have a pile-up on the concrete.\n" );
+          printf( "\t%d crossing sago -> monkey grass\n", numCrossingSago2MonkeyGrass );
+          printf( "\t%d crossing monkey grass -> sago\n", numCrossingMonkeyGrass2Sago );
+          exit( -1 );
+        }
+
+      // The program did not exit, unlock the counter
+      UNLOCK(liz_lock); // LK AM
+    }
+
+  /*
+   * It takes a while to cross, so simulate it (the benchmark's
+   * lizards cross instantly, without a system call)
+   */
+  if (crossSeconds > 0)
+    world_sleep( crossSeconds );
+
+  /*
+   * That one seems to have made it
+   */
+  
+  if (atomicCounters)
+    __atomic_fetch_sub(&crossingCounts, CROSSING_ONE(SAGO_2_MONKEYGRASS), __ATOMIC_RELEASE);
+  else
+    {
+      // There is a shared counter here. Lock and access it.
+      LOCK(liz_lock); // LK AM
+      numCrossingSago2MonkeyGrass--;
+      UNLOCK(liz_lock); // LK AM
+    }
+}
+
+
+/*
+ * made_it_2_monkeyGrass()
+ *
+ * Tells others they can go now
+ * input: lizard number
+ * output: N/A
+ * Status: Incomplete - Make changes as you see are necessary.
+ */
+void made_it_2_monkeyGrass(int num)
+{
+  /*
+   * Whew, made it across
+   */
+  if (debug)
+    {
+      printf( "[%2d] made the  sago -> monkey grass  crossing\n", num );
+      fflush( stdout );
+    }
+
+  // Let the next lizard know that it is safe to cross
+  if (unidirectional)
+    direction_unlock(&crossingTurns);
+  SEM_POST(driveway); // LK AM
+
+}
+
+
+/*
+ * lizard_eat()
+ *
+ * Simulate a lizard eating for a random amount of time
+ * input: lizard number
+ * output: N/A
+ * Status: Completed - No need to change any of this code.
+ */
+void lizard_eat(int num)
+{
+  int eatSeconds;
+
+  eatSeconds = random_seconds(maxLizardEat);
+
+  if (debug)
+    {
+      printf( "[%2d] eating for %d seconds\n", num, eatSeconds );
+      fflush( stdout );
+    }
+
+  /*
+   * Simulate eating by blocking for a few seconds
+   */
+  world_sleep( eatSeconds );
+
+  if (debug)
+    {
+      printf( "[%2d] finished eating\n", num );
+      fflush( stdout );
+    }
+}
+
+
+/*
+ * monkeyGrass_2_sago_is_safe()
+ *
+ * Returns when it is safe for this lizard to cross from the monkey
+ * grass to the sago.   Should use some synchronization 
+ * facilities (lock/semaphore) here.
+ * input: lizard number
+ * output: N/A
+ * Status: Incomplete - Make changes as you see are necessary.
+ */
+void monkeyGrass_2_sago_is_safe(int num)
+{
+  if (debug)
+    {
+      printf( "[%2d] checking  monkey grass -> sago\n", num );
+      fflush( stdout );
+    }
+
+  // Wait until it is safe to cross the road
+  SEM_WAIT(driveway); // LK AM
+
+  // And, in unidirectional mode, until it is this direction's turn
+  if (unidirectional)
+    direction_lock(&crossingTurns, MONKEYGRASS_2_SAGO);
+
+
+  if (debug)
+    {
+      printf( "[%2d] thinks  monkey grass -> sago  is safe\n", num );
+      fflush( stdout );
+    }
+}
+
+
+
+/*
+ * cross_monkeyGrass_2_sago()
+ *
+ * Delays for 1 second to simulate crossing from the monkey
+ * grass to the sago. 
+ * input: lizard number
+ * output: N/A
+ * Status: Incomplete - Make changes as you see are necessary.
+ */
+void cross_monkeyGrass_2_sago(int num)
+{
+  if (debug)
+    {
+      printf( "[%2d] crossing  monkey grass -> sago\n", num );
+      fflush( stdout );
+    }
+
+  /*
+   * One more crossing this way, then check for lizards crossing
+   * both ways.  The atomic counters do both in one step.
+   */
+  if (atomicCounters)
+    atomic_crossing_started(MONKEYGRASS_2_SAGO);
+  else
+    {
+      // A shared counter is being accessed. Lock it, read, then unlock.
+      LOCK(liz_lock); // LK AM
+      numCrossingMonkeyGrass2Sago++;
+      cats_watch(numCrossingSago2MonkeyGrass + numCrossingMonkeyGrass2Sago);
+
+      if (debug)
+        {
+          printf("Lizards crossing: %d\n", numCrossingSago2MonkeyGrass+numCrossingMonkeyGrass2Sago); // LK AM
+        }
+
+      UNLOCK(liz_lock); // LK AM
+
+      // A shared counter is being accessed in the if statement. Lock it, read, then unlock.
+      LOCK(liz_lock); // LK AM
+
+      if (numCrossingSago2MonkeyGrass && unidirectional)
+        {
+          printf( "\tOh No!, the lizards have cats all over them.\n" );
+          printf( "\t%d crossing sago -> monkey grass\n", numCrossingSago2MonkeyGrass );
+          printf( "\t%d crossing monkey grass -> sago\n", numCrossingMonkeyGrass2Sago );
+          exit( -1 );
+        }
+
+      // The program did not exit. Unlock the lock.
+      UNLOCK(liz_lock); // LK AM
+    }
+  
+  /*
+   * It takes a while to cross, so simulate it (the benchmark's
+   * lizards cross instantly, without a system call)
+   */
+  if (crossSeconds > 0)
+    world_sleep( crossSeconds );
+
+  /*
+   * That one seems to have made it
+   */
+  
+  if (atomicCounters)
+    __atomic_fetch_sub(&crossingCounts, CROSSING_ONE(MONKEYGRASS_2_SAGO), __ATOMIC_RELEASE);
+  else
+    {
+      // A shared counter is being accessed. Lock it, read, then unlock.
+      LOCK(liz_lock); // LK AM
+      numCrossingMonkeyGrass2Sago--;
+      UNLOCK(liz_lock); // LK AM
+    }
+}
+
+
+/*
+ * made_it_2_sago()
+ *
+ * Tells others they can go now
+ * input: lizard number
+ * output: N/A
+ * Status: Incomplete - Make changes as you see are necessary.
+ */
+void made_it_2_sago(int num)
+{
+  /*
+   * Whew, made it across
+   */
+  if (debug)
+    {
+      printf( "[%2d] made the  monkey grass -> sago  crossing\n", num );
+      fflush( stdout );
+    }
+
+  // Let the next lizard know that crossing is safe
+  if (unidirectional)
+    direction_unlock(&crossingTurns);
+  SEM_POST(driveway); // LK AM
+}
+
+
+
+/*
+ * atomic_crossing_started()
+ *
+ * Counts one more lizard crossing in a direction and checks for
+ * lizards crossing the other way, with a single atomic add
+ * input: SAGO_2_MONKEYGRASS or MONKEYGRASS_2_SAGO
+ * output: N/A
+ */
+void atomic_crossing_started(int direction)
+{
+  unsigned long long counts = __atomic_add_fetch(&crossingCounts, CROSSING_ONE(direction), __ATOMIC_ACQ_REL);
+  int sago2MonkeyGrass = CROSSING_COUNT(counts, SAGO_2_MONKEYGRASS);
+  int monkeyGrass2Sago = CROSSING_COUNT(counts, MONKEYGRASS_2_SAGO);
+
+  // The count this lizard made, so the cats see every crowd
+  cats_watch(sago2MonkeyGrass + monkeyGrass2Sago);
 
   if (debug)
     {
-      printf( "[%2d] thinks  sago -> monkey grass  is safe\n", num );
-      fflush( stdout );
+      printf("Lizards crossing: %d\n", sago2MonkeyGrass + monkeyGrass2Sago);
+    }
+
+  if (unidirectional && CROSSING_COUNT(counts, !direction))
+    {
+      if (direction == SAGO_2_MONKEYGRASS)
+        printf( "\tCrash!  We have a pile-up on the concrete.\n" );
+      else
+        printf( "\tOh No!, the lizards have cats all over them.\n" );
+      printf( "\t%d crossing sago -> monkey grass\n", sago2MonkeyGrass );
+      printf( "\t%d crossing monkey grass -> sago\n", monkeyGrass2Sago );
+      exit( -1 );
     }
 }
 
 
 /*
- * cross_sago_2_monkeyGrass()
+ * The benchmark threads start together, and each notes when it
+ * started and finished (in seconds).  benchMode picks the variant
+ * being timed.
+ */
+pthread_barrier_t benchStart;
+double *benchBegin, *benchEnd;
+int benchMode;
+
+/*
+ * benchThread()
  *
- * Delays for 1 second to simulate crossing from the sago to
- * the monkey grass. 
+ * A lizard that never sleeps or eats: it crosses back and forth
+ * BENCH_CROSSINGS times, so only the crossing counters are timed
  * input: lizard number
  * output: N/A
- * Status: Incomplete - Make changes as you see are necessary.
  */
-void cross_sago_2_monkeyGrass(int num)
+void * benchThread( void * param )
 {
-  if (debug)
+  int num = *(int*)param;
+  int i;
+
+  pthread_barrier_wait(&benchStart);
+  benchBegin[num] = world_now();
+
+  for (i = 0; i < BENCH_CROSSINGS / 2; i++)
     {
-      printf( "[%2d] crossing  sago -> monkey grass\n", num );
-      fflush( stdout );
+      cross_sago_2_monkeyGrass(num);
+      cross_monkeyGrass_2_sago(num);
     }
 
-  /*
-   * One more crossing this way
-   */
-   
-  // There is a shared counter here. Lock and access it.
-  pthread_mutex_lock(&liz_lock); // LK AM
-  numCrossingSago2MonkeyGrass++;
-  
-  if (debug)
-	{
-	   printf("Lizards crossing: %d\n", numCrossingSago2MonkeyGrass+numCrossingMonkeyGrass2Sago); // LK AM
-	}
-  
-  pthread_mutex_unlock(&liz_lock); // LK AM
+  benchEnd[num] = world_now();
 
-  /*
-   * Check for lizards cross both ways
-   */
-  
-  // There is a shared counter in the if statement. Lock and access it.
-  pthread_mutex_lock(&liz_lock); // LK AM
-  
-  if (numCrossingMonkeyGrass2Sago && UNIDIRECTIONAL)
+  pthread_exit(NULL);
+}
+
+/*
+ * benchRandomThread()
+ *
+ * A lizard that only draws BENCH_DRAWS random numbers, from
+ * random() (benchMode 0) or its own generator (benchMode 1)
+ * input: lizard number
+ * output: N/A
+ */
+void * benchRandomThread( void * param )
+{
+  int num = *(int*)param;
+  volatile long sum = 0;
+  int i;
+
+  rng_seed(&threadRng, seed, num);
+  pthread_barrier_wait(&benchStart);
+  benchBegin[num] = world_now();
+
+  for (i = 0; i < BENCH_DRAWS; i++)
+    sum += benchMode ? (long)(rng_next(&threadRng) >> 33) : random();
+
+  benchEnd[num] = world_now();
+
+  pthread_exit(NULL);
+}
+
+/*
+ * bench_run()
+ *
+ * Starts numLizards benchmark threads together and waits for them
+ * input: thread function, thread attributes
+ * output: seconds from the first thread starting to the last one
+ *         finishing
+ */
+double bench_run(void *(*body)(void *), pthread_attr_t *attr)
+{
+  pthread_t *lizard = malloc(sizeof(pthread_t) * numLizards);
+  int *nums = malloc(sizeof(int) * numLizards);
+  int i;
+
+  if (lizard == NULL || nums == NULL)
     {
-	  printf( "\tCrash!  We have a pile-up on the concrete.\n" );
-	  printf( "\t%d crossing sago -> monkey grass\n", numCrossingSago2MonkeyGrass );
-	  printf( "\t%d crossing monkey grass -> sago\n", numCrossingMonkeyGrass2Sago );
-	  exit( -1 );
+      printf("Unable to allocate the thread tables.\n");
+      exit( -1 );
     }
 
-  // The program did not exit, unlock the counter
-  pthread_mutex_unlock(&liz_lock); // LK AM
+  pthread_barrier_init(&benchStart, NULL, numLizards + 1);
 
-  /*
-   * It takes a while to cross, so simulate it
-   */
-  sleep( CROSS_SECONDS );
+  for (i = 0; i < numLizards; i++)
+    {
+      nums[i] = i;
+      if (pthread_create(&lizard[i], attr, body, &nums[i]) != 0)
+        {
+          printf("Unable to create lizard %d.\n", i);
+          exit( -1 );
+        }
+    }
 
-  /*
-   * That one seems to have made it
-   */
-  
-  // There is a shared counter here. Lock and access it.
-  pthread_mutex_lock(&liz_lock); // LK AM
-  numCrossingSago2MonkeyGrass--;
-  pthread_mutex_unlock(&liz_lock); // LK AM
-}
+  pthread_barrier_wait(&benchStart);
+
+  for (i = 0; i < numLizards; i++)
+    pthread_join(lizard[i], NULL);
+
+  pthread_barrier_destroy(&benchStart);
+  free(lizard);
+  free(nums);
+
+  double first = benchBegin[0], last = benchEnd[0];
+
+  for (i = 1; i < numLizards; i++)
+    {
+      if (benchBegin[i] < first)
+        first = benchBegin[i];
+      if (benchEnd[i] > last)
+        last = benchEnd[i];
+    }
 
+  return last - first;
+}
 
 /*
- * made_it_2_monkeyGrass()
+ * runBenchmarks()
  *
- * Tells others they can go now
- * input: lizard number
+ * Times numLizards lizards crossing with the counters under
+ * liz_lock and then with the atomic counters, and drawing random
+ * numbers from random() and then from their own generators.
+ * Crossings take no time and lizards cross both ways at once, so
+ * debugging output, the unidirectional check and the cats' limit
+ * are turned off.
+ * input: N/A
  * output: N/A
- * Status: Incomplete - Make changes as you see are necessary.
  */
-void made_it_2_monkeyGrass(int num)
+void runBenchmarks(void)
 {
-  /*
-   * Whew, made it across
-   */
-  if (debug)
+  pthread_attr_t attr;
+  double seconds;
+  long count;
+
+  benchBegin = malloc(sizeof(double) * numLizards);
+  benchEnd = malloc(sizeof(double) * numLizards);
+  if (benchBegin == NULL || benchEnd == NULL)
     {
-      printf( "[%2d] made the  sago -> monkey grass  crossing\n", num );
-      fflush( stdout );
+      printf("Unable to allocate the thread tables.\n");
+      exit( -1 );
     }
 
-  // Let the next lizard know that it is safe to cross
-  sem_post(&driveway); // LK AM
+  debug = 0;
+  unidirectional = 0;
+  crossSeconds = 0;
+  maxLizardCrossing = numLizards;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, (size_t)stackKb * 1024);
+
+  count = (long)numLizards * (BENCH_CROSSINGS / 2) * 2;
+  for (atomicCounters = 0; atomicCounters <= 1; atomicCounters++)
+    {
+      seconds = bench_run(benchThread, &attr);
+      printf("%-8s %d lizards: %ld crossings in %.6f s, %.0f crossings/s\n",
+             atomicCounters ? "atomic" : "liz_lock", numLizards, count, seconds, count / seconds);
+    }
 
+  count = (long)numLizards * BENCH_DRAWS;
+  for (benchMode = 0; benchMode <= 1; benchMode++)
+    {
+      seconds = bench_run(benchRandomThread, &attr);
+      printf("%-8s %d lizards: %ld draws in %.6f s, %.0f draws/s\n",
+             benchMode ? "xoshiro" : "random", numLizards, count, seconds, count / seconds);
+    }
+
+  pthread_attr_destroy(&attr);
+  free(benchBegin);
+  free(benchEnd);
 }
 
+/***************************************************************/
+/*                                                             */
+/* Discrete-event simulation                                   */
+/*                                                             */
+/* The same world, run on a virtual clock by a single thread.  */
+/* Every lizard is a state machine with at most one pending    */
+/* event in a priority queue ordered by virtual time.  The     */
+/* driveway semaphore is modelled by its count and a FIFO of   */
+/* waiting lizards, and the crossing counters and the cats'    */
+/* watch follow the threaded functions above step by step,     */
+/* so a world that loses in real time also loses here.  In     */
+/* unidirectional mode the lizards take turns by direction     */
+/* with the same rules as direction_lock().                    */
+/*                                                             */
+/***************************************************************/
+
+/*
+ * What a lizard is doing when its next event fires
+ */
+#define SIM_SLEEPING       0   /* lizard_sleep() */
+#define SIM_CROSSING_2_MG  1   /* cross_sago_2_monkeyGrass() */
+#define SIM_EATING         2   /* lizard_eat() */
+#define SIM_CROSSING_2_S   3   /* cross_monkeyGrass_2_sago() */
+#define SIM_WAITING        4   /* blocked in sem_wait(&driveway) */
 
 /*
- * lizard_eat()
+ * One pending event: actor wakes up at virtual time "time".
+ * Ties are broken by the order the events were scheduled in.
+ */
+typedef struct
+{
+  double time;
+  long seq;
+  int actor;    /* lizard number */
+} SimEvent;
+
+/*
+ * The state of the simulated world
+ */
+typedef struct
+{
+  double now;             /* the virtual clock */
+  long nextSeq;           /* order of the next scheduled event */
+  long eventCount;        /* events processed */
+  long crossings;         /* driveway crossings completed */
+  SimEvent *heap;         /* pending events, a binary min-heap */
+  int heapSize;
+  int *state;             /* SIM_* state of every lizard */
+  int drivewayCount;      /* the value of the driveway semaphore */
+  int *waiters;           /* lizards blocked on the driveway, a ring */
+  int waitHead, waitCount;
+  double *wanted;         /* when every lizard started to wait for the driveway */
+  DirectionState turns;   /* whose turn it is in unidirectional mode */
+  int *turnWaiters[2];    /* lizards holding the driveway, waiting for their turn, rings */
+  int turnHead[2], turnCount[2];
+} SimWorld;
+
+/*
+ * Returns 1 if event a fires before event b
+ */
+static int sim_before(const SimEvent *a, const SimEvent *b)
+{
+  return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+/*
+ * sim_schedule()
  *
- * Simulate a lizard eating for a random amount of time
- * input: lizard number
+ * Wakes an actor up after a delay on the virtual clock
+ * input: world, actor number, delay in seconds
  * output: N/A
- * Status: Completed - No need to change any of this code.
  */
-void lizard_eat(int num)
+static void sim_schedule(SimWorld *world, int actor, double delay)
 {
-  int eatSeconds;
+  int i = world->heapSize++;
+  SimEvent event;
 
-  eatSeconds = 1 + (int)(random() / (double)RAND_MAX * MAX_LIZARD_EAT);
+  event.time = world->now + delay;
+  event.seq = world->nextSeq++;
+  event.actor = actor;
 
-  if (debug)
+  // Sift the new event up to its place
+  while (i > 0 && sim_before(&event, &world->heap[(i - 1) / 2]))
     {
-      printf( "[%2d] eating for %d seconds\n", num, eatSeconds );
-      fflush( stdout );
+      world->heap[i] = world->heap[(i - 1) / 2];
+      i = (i - 1) / 2;
     }
+  world->heap[i] = event;
+}
 
-  /*
-   * Simulate eating by blocking for a few seconds
-   */
-  sleep( eatSeconds );
+/*
+ * sim_next()
+ *
+ * Removes the earliest pending event
+ * input: world
+ * output: the event
+ */
+static SimEvent sim_next(SimWorld *world)
+{
+  SimEvent first = world->heap[0];
+  SimEvent last = world->heap[--world->heapSize];
+  int i = 0;
 
-  if (debug)
+  // Sift the last event down from the root
+  while (2 * i + 1 < world->heapSize)
     {
-      printf( "[%2d] finished eating\n", num );
-      fflush( stdout );
+      int child = 2 * i + 1;
+
+      if (child + 1 < world->heapSize && sim_before(&world->heap[child + 1], &world->heap[child]))
+        child++;
+      if (!sim_before(&world->heap[child], &last))
+        break;
+
+      world->heap[i] = world->heap[child];
+      i = child;
     }
-}
+  world->heap[i] = last;
 
+  return first;
+}
 
 /*
- * monkeyGrass_2_sago_is_safe()
+ * sim_start_crossing()
  *
- * Returns when it is safe for this lizard to cross from the monkey
- * grass to the sago.   Should use some synchronization 
- * facilities (lock/semaphore) here.
- * input: lizard number
+ * A lizard holds the driveway and starts to cross, exactly like
+ * cross_sago_2_monkeyGrass() and cross_monkeyGrass_2_sago()
+ * input: world, lizard number, the crossing state
  * output: N/A
- * Status: Incomplete - Make changes as you see are necessary.
  */
-void monkeyGrass_2_sago_is_safe(int num)
+static void sim_start_crossing(SimWorld *world, int num, int crossing)
 {
-  if (debug)
+  // The cats wake up as soon as the driveway gets too crowded,
+  // like cats_watch()
+  if (numCats > 0 && numCrossingSago2MonkeyGrass + numCrossingMonkeyGrass2Sago + 1 > maxLizardCrossing)
     {
-      printf( "[%2d] checking  monkey grass -> sago\n", num );
-      fflush( stdout );
+      printf( "\tThe cats are happy - they have toys (at %.0f seconds).\n", world->now );
+      exit( -1 );
     }
 
-  // Wait until it is safe to cross the road
-  sem_wait(&driveway); // LK AM
-
+  if (crossing == SIM_CROSSING_2_MG)
+    {
+      numCrossingSago2MonkeyGrass++;
+
+      if (numCrossingMonkeyGrass2Sago && unidirectional)
+        {
+          printf( "\tCrash!  We have a pile-up on the concrete at %.0f seconds.\n", world->now );
+          printf( "\t%d crossing sago -> monkey grass\n", numCrossingSago2MonkeyGrass );
+          printf( "\t%d crossing monkey grass -> sago\n", numCrossingMonkeyGrass2Sago );
+          exit( -1 );
+        }
+    }
+  else
+    {
+      numCrossingMonkeyGrass2Sago++;
+
+      if (numCrossingSago2MonkeyGrass && unidirectional)
+        {
+          printf( "\tOh No!, the lizards have cats all over them at %.0f seconds.\n", world->now );
+          printf( "\t%d crossing sago -> monkey grass\n", numCrossingSago2MonkeyGrass );
+          printf( "\t%d crossing monkey grass -> sago\n", numCrossingMonkeyGrass2Sago );
+          exit( -1 );
+        }
+    }
 
   if (debug)
     {
-      printf( "[%2d] thinks  monkey grass -> sago  is safe\n", num );
-      fflush( stdout );
+      printf( "%8.1f [%2d] crossing  %s\n", world->now, num,
+              (crossing == SIM_CROSSING_2_MG) ? "sago -> monkey grass" : "monkey grass -> sago" );
     }
+
+  world->state[num] = crossing;
+  sim_schedule(world, num, crossSeconds);
 }
 
+/*
+ * sim_admit()
+ *
+ * Lets every lizard whose direction has its turn start to cross
+ * input: world
+ * output: N/A
+ */
+static void sim_admit(SimWorld *world)
+{
+  int admitted = 1;
+  int direction;
 
+  while (admitted)
+    {
+      admitted = 0;
+      for (direction = 0; direction < 2; direction++)
+        {
+          while (world->turnCount[direction] > 0 &&
+                 direction_may_enter(&world->turns, direction, world->now))
+            {
+              int num = world->turnWaiters[direction][world->turnHead[direction]];
+
+              world->turnHead[direction] = (world->turnHead[direction] + 1) % numLizards;
+              world->turnCount[direction]--;
+              direction_enter(&world->turns, direction, world->now);
+              direction_record(&world->turns, direction, world->now - world->wanted[num]);
+              sim_start_crossing(world, num, world->state[num]);
+              admitted = 1;
+            }
+        }
+    }
+}
 
 /*
- * cross_monkeyGrass_2_sago()
+ * sim_take_driveway()
  *
- * Delays for 1 second to simulate crossing from the monkey
- * grass to the sago. 
- * input: lizard number
+ * A lizard got the driveway semaphore.  In unidirectional mode it
+ * still waits for its direction's turn, like direction_lock().
+ * input: world, lizard number, the crossing state
  * output: N/A
- * Status: Incomplete - Make changes as you see are necessary.
  */
-void cross_monkeyGrass_2_sago(int num)
+static void sim_take_driveway(SimWorld *world, int num, int crossing)
 {
-  if (debug)
+  int direction = (crossing == SIM_CROSSING_2_MG) ? SAGO_2_MONKEYGRASS : MONKEYGRASS_2_SAGO;
+
+  if (!unidirectional)
     {
-      printf( "[%2d] crossing  monkey grass -> sago\n", num );
-      fflush( stdout );
+      sim_start_crossing(world, num, crossing);
+      return;
     }
 
-  /*
-   * One more crossing this way
-   */
-  
-  // A shared counter is being accessed. Lock it, read, then unlock.
-  pthread_mutex_lock(&liz_lock); // LK AM
-  numCrossingMonkeyGrass2Sago++;
-  
-  if (debug)
+  world->state[num] = crossing;
+  direction_wait(&world->turns, direction, world->now);
+  world->turnWaiters[direction][(world->turnHead[direction] + world->turnCount[direction]) % numLizards] = num;
+  world->turnCount[direction]++;
+  sim_admit(world);
+}
+
+/*
+ * sim_driveway_wait()
+ *
+ * sem_wait(&driveway) for a lizard about to cross: it either takes
+ * the driveway now or joins the FIFO of waiting lizards
+ * input: world, lizard number, the crossing state
+ * output: N/A
+ */
+static void sim_driveway_wait(SimWorld *world, int num, int crossing)
+{
+  world->wanted[num] = world->now;
+
+  if (world->drivewayCount > 0)
     {
-	   printf("Lizards crossing: %d\n", numCrossingSago2MonkeyGrass+numCrossingMonkeyGrass2Sago); // LK AM
+      world->drivewayCount--;
+      sim_take_driveway(world, num, crossing);
+      return;
     }
 
-  pthread_mutex_unlock(&liz_lock); // LK AM
+  // Remember the direction in the waiting state until it is woken
+  world->state[num] = crossing;
+  world->waiters[(world->waitHead + world->waitCount) % numLizards] = num;
+  world->waitCount++;
+}
 
-  /*
-   * Check for lizards cross both ways
-   */
-  
-  // A shared counter is being accessed in the if statement. Lock it, read, then unlock.
-  pthread_mutex_lock(&liz_lock); // LK AM
-  
-  if (numCrossingSago2MonkeyGrass && UNIDIRECTIONAL)
+/*
+ * sim_driveway_post()
+ *
+ * sem_post(&driveway) from a lizard that made it across: the
+ * longest-waiting lizard (if any) takes the driveway over
+ * input: world
+ * output: N/A
+ */
+static void sim_driveway_post(SimWorld *world)
+{
+  if (world->waitCount == 0)
     {
-      printf( "\tOh No!, the lizards have cats all over them.\n" );
-      printf( "\t%d crossing sago -> monkey grass\n", numCrossingSago2MonkeyGrass );
-      printf( "\t%d crossing monkey grass -> sago\n", numCrossingMonkeyGrass2Sago );
-      exit( -1 );
+      world->drivewayCount++;
+      return;
     }
 
-  // The program did not exit. Unlock the lock.
-  pthread_mutex_unlock(&liz_lock); // LK AM
-  
-  /*
-   * It takes a while to cross, so simulate it
-   */
-  sleep( CROSS_SECONDS );
+  int num = world->waiters[world->waitHead];
+  world->waitHead = (world->waitHead + 1) % numLizards;
+  world->waitCount--;
 
-  /*
-   * That one seems to have made it
-   */
-  
-  // A shared counter is being accessed. Lock it, read, then unlock.
-  pthread_mutex_lock(&liz_lock); // LK AM
-  numCrossingMonkeyGrass2Sago--;
-  pthread_mutex_unlock(&liz_lock); // LK AM
+  sim_take_driveway(world, num, world->state[num]);
 }
 
+/*
+ * sim_made_it()
+ *
+ * A lizard is off the driveway: like direction_unlock() and then
+ * sem_post(&driveway)
+ * input: world
+ * output: N/A
+ */
+static void sim_made_it(SimWorld *world)
+{
+  world->crossings++;
+
+  if (unidirectional)
+    {
+      world->turns.active--;
+      sim_admit(world);
+    }
+
+  sim_driveway_post(world);
+}
 
 /*
- * made_it_2_sago()
+ * sim_lizard()
  *
- * Tells others they can go now
- * input: lizard number
+ * Advances a lizard to its next step when its event fires, following
+ * the loop in lizardThread()
+ * input: world, lizard number
  * output: N/A
- * Status: Incomplete - Make changes as you see are necessary.
  */
-void made_it_2_sago(int num)
+static void sim_lizard(SimWorld *world, int num)
 {
-  /*
-   * Whew, made it across
-   */
-  if (debug)
+  switch (world->state[num])
     {
-      printf( "[%2d] made the  monkey grass -> sago  crossing\n", num );
-      fflush( stdout );
+    case SIM_SLEEPING:
+      // Awake: stay home if the world has ended, else wait for the
+      // driveway to the monkey grass
+      if (world->now < worldEnd)
+        sim_driveway_wait(world, num, SIM_CROSSING_2_MG);
+      break;
+
+    case SIM_CROSSING_2_MG:
+      // Made it: free the driveway and eat
+      numCrossingSago2MonkeyGrass--;
+      sim_made_it(world);
+      world->state[num] = SIM_EATING;
+      sim_schedule(world, num, random_seconds(maxLizardEat));
+      break;
+
+    case SIM_EATING:
+      // Full: wait for the driveway back to the sago
+      sim_driveway_wait(world, num, SIM_CROSSING_2_S);
+      break;
+
+    case SIM_CROSSING_2_S:
+      // Home: free the driveway and sleep, unless the world has ended
+      numCrossingMonkeyGrass2Sago--;
+      sim_made_it(world);
+      if (world->now < worldEnd)
+        {
+          world->state[num] = SIM_SLEEPING;
+          sim_schedule(world, num, random_seconds(maxLizardSleep));
+        }
+      break;
     }
+}
 
-  // Let the next lizard know that crossing is safe
-  sem_post(&driveway); // LK AM
+/*
+ * simulateWorld()
+ *
+ * Runs the whole world on the virtual clock and reports how long
+ * that took in real time
+ * input: N/A
+ * output: N/A
+ */
+void simulateWorld(void)
+{
+  SimWorld world;
+  struct timespec start, finish;
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  memset(&world, 0, sizeof(world));
+  world.heap = malloc(sizeof(SimEvent) * numLizards);
+  world.state = malloc(sizeof(int) * numLizards);
+  world.waiters = malloc(sizeof(int) * numLizards);
+  world.wanted = malloc(sizeof(double) * numLizards);
+  world.turnWaiters[0] = malloc(sizeof(int) * numLizards);
+  world.turnWaiters[1] = malloc(sizeof(int) * numLizards);
+  world.drivewayCount = maxLizardCrossing;
+
+  if (world.heap == NULL || world.state == NULL || world.waiters == NULL || world.wanted == NULL ||
+      world.turnWaiters[0] == NULL || world.turnWaiters[1] == NULL)
+    {
+      printf("Unable to allocate the simulated world.\n");
+      exit( -1 );
+    }
+
+  // Every lizard starts out asleep in the sago
+  for (i = 0; i < numLizards; i++)
+    {
+      world.state[i] = SIM_SLEEPING;
+      sim_schedule(&world, i, random_seconds(maxLizardSleep));
+    }
+
+  // After the end of the world, the lizards still finish their round trip
+  while (world.heapSize > 0)
+    {
+      SimEvent event = sim_next(&world);
+
+      world.now = event.time;
+      world.eventCount++;
+
+      sim_lizard(&world, event.actor);
+    }
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+
+  printf("Simulated %d seconds (last lizard home at %.0f) with %d lizards and %d cats: "
+         "%ld crossings, %ld events in %.3f ms\n",
+         worldEnd, world.now, numLizards, numCats, world.crossings, world.eventCount,
+         (finish.tv_sec - start.tv_sec) * 1e3 + (finish.tv_nsec - start.tv_nsec) / 1e6);
+
+  if (unidirectional)
+    print_directions(&world.turns, world.now);
+
+  free(world.heap);
+  free(world.state);
+  free(world.waiters);
+  free(world.wanted);
+  free(world.turnWaiters[0]);
+  free(world.turnWaiters[1]);
 }
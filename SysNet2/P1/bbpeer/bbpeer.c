@@ -143,6 +143,9 @@ int main(int argc, char **argv) {
 
         }
 
+        // Post the messages queued by the terminal while the token is held
+        flushPendingWrites();
+
         // Check if the peer is wishing to leave
 		if (exitPending())
 		{
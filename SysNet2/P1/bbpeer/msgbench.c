@@ -0,0 +1,143 @@
+/**
+ * File:   msgbench.c
+ *
+ * Measures how fast the message log can be scanned. A scratch log of generated
+ * messages is written to a temporary directory and scanned for its last ID
+ * with the stdio reader (SCAN_STDIO) and the memory-mapped reader (SCAN_MMAP)
+ * of msgparser. The throughput of each is printed in MB/s.
+ *
+ * Usage: msgbench [messages] [repeats]
+ *
+ * @author Luke Kledzik
+ * @author Adam Mooers
+ * @date 2/13/2017
+ * @info Course COP4635
+ */
+
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <time.h>
+ #include <unistd.h>
+ #include <sys/stat.h>
+ #include "msgparser.h"
+
+ // Defaults for the command line arguments
+ #define DEFAULT_MESSAGES 100000
+ #define DEFAULT_REPEATS 5
+
+/**
+ * Writes a log of generated messages in the format described in msgparser.h.
+ * Bodies have one to four lines of varying length.
+ *
+ * @param messages the number of messages to write
+ * @return the size of the log in bytes, or -1 if it cannot be written
+ */
+
+ long long writeBenchLog(int messages);
+
+/**
+ * Scans the log repeatedly with one method and prints the throughput.
+ *
+ * @param name the name printed for the method
+ * @param method SCAN_STDIO or SCAN_MMAP
+ * @param repeats how many scans to time
+ * @param logSize the size of the log in bytes
+ * @param messages the number of messages expected
+ */
+
+ void benchScan(const char* name, int method, int repeats, long long logSize, int messages);
+
+ int main(int argc, char** argv)
+ {
+     int messages = (argc > 1) ? atoi(argv[1]) : DEFAULT_MESSAGES;
+     int repeats = (argc > 2) ? atoi(argv[2]) : DEFAULT_REPEATS;
+     char scratch[] = "/tmp/msgbench.XXXXXX";
+
+     if (messages < 1 || repeats < 1)
+     {
+         fprintf(stderr, "Usage: %s [messages] [repeats]\n", argv[0]);
+         return 1;
+     }
+
+     // MSG_LOG is a relative path, so work in a scratch directory
+     if (mkdtemp(scratch) == NULL || chdir(scratch) != 0)
+     {
+         perror("Error creating scratch directory");
+         return 1;
+     }
+
+     long long logSize = writeBenchLog(messages);
+
+     if (logSize > 0)
+     {
+         printf("%d messages, %.1f MB, best of %d scans\n", messages, logSize / 1e6, repeats);
+         benchScan("stdio", SCAN_STDIO, repeats, logSize, messages);
+         benchScan("mmap", SCAN_MMAP, repeats, logSize, messages);
+     }
+
+     remove(MSG_LOG);
+     rmdir(scratch);
+
+     return (logSize > 0) ? 0 : 1;
+ }
+
+ long long writeBenchLog(int messages)
+ {
+     FILE *msgLog = fopen(MSG_LOG, "wb");
+     int msgID, line;
+
+     if (msgLog == NULL)
+     {
+         perror("Error creating message log");
+         return -1;
+     }
+
+     for (msgID = FIRST_MESSAGE_INDEX; msgID < FIRST_MESSAGE_INDEX + messages; msgID++)
+     {
+         fprintf(msgLog, OPENING_XML_TAG_FORMAT"\n", msgID);
+
+         for (line = 0; line <= msgID % 4; line++)
+         {
+             fprintf(msgLog, "Message %d line %d: %.*s\n", msgID, line, 10 + (msgID * 7 + line) % 50,
+                     "the quick brown fox jumps over the lazy dog, again and again");
+         }
+
+         fprintf(msgLog, CLOSING_XML_TAG_FORMAT"\n");
+     }
+
+     long long logSize = ftell(msgLog);
+
+     if (fclose(msgLog) != 0)
+     {
+         perror("Error writing message log");
+         return -1;
+     }
+
+     return logSize;
+ }
+
+ void benchScan(const char* name, int method, int repeats, long long logSize, int messages)
+ {
+     double best = 0;
+     int lastID = FIRST_MESSAGE_INDEX-1;
+     int i;
+
+     for (i = 0; i < repeats; i++)
+     {
+         struct timespec start, end;
+
+         clock_gettime(CLOCK_MONOTONIC, &start);
+         lastID = scanMessageLog(method);
+         clock_gettime(CLOCK_MONOTONIC, &end);
+
+         double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+         if (i == 0 || seconds < best)
+         {
+             best = seconds;
+         }
+     }
+
+     printf("%-6s %8.3f ms %10.1f MB/s%s\n", name, best * 1e3, logSize / 1e6 / best,
+            (lastID == FIRST_MESSAGE_INDEX-1 + messages) ? "" : "  (wrong last ID)");
+ }
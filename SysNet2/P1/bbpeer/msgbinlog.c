@@ -0,0 +1,800 @@
+/**
+ * File:   msgbinlog.c
+ *
+ * Implements msgbinlog.h. See msgbinlog.h for details.
+ *
+ * @author Luke Kledzik
+ * @author Adam Mooers
+ * @date 2/13/2017
+ * @info Course COP4635
+ */
+
+ #define _GNU_SOURCE
+ #include <stdlib.h>
+ #include <string.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/stat.h>
+ #include "msgparser.h"
+ #include "msgbinlog.h"
+
+ // Reflected polynomial of CRC-32C (Castagnoli)
+ #define CRC32C_POLY 0x82f63b78
+
+ // Bytes read at a time while looking for the next record after damage
+ #define BIN_SCAN_BYTES (64*1024)
+
+ /**
+  * The header of a record, as decoded from its MSG_BIN_HEADER_SIZE little-endian
+  * bytes. See msgbinlog.h.
+  */
+ struct MSG_BIN_HEADER
+ {
+     unsigned int magic;     /* MSG_BIN_MAGIC */
+     unsigned int id;        /* message ID */
+     unsigned int length;    /* bytes in the body */
+     unsigned int crc;       /* CRC-32C of the header (crc = 0) and body */
+ };
+
+ typedef struct MSG_BIN_HEADER MsgBinHeader_t;
+
+ /**
+  * Where a record of the binary log is.
+  */
+ struct MSG_BIN_RECORD
+ {
+     long long offset;       /* first byte of the record header */
+     int id;                 /* message ID */
+     unsigned int length;    /* bytes in the body */
+ };
+
+ typedef struct MSG_BIN_RECORD MsgBinRecord_t;
+
+ /**
+  * The records of the binary log walked so far. The walk continues where it
+  * stopped when the log grows, and starts over if the log is replaced or shrinks.
+  * Damaged records are kept too (reading them reports the damage), so that
+  * lastID counts them and their IDs are never handed out again.
+  */
+ struct MSG_BIN_CACHE
+ {
+     dev_t device;           /* identity of the walked file */
+     ino_t inode;
+     long long validEnd;     /* end of the last record walked */
+     int tailDamaged;        /* the bytes after validEnd are not a torn record */
+     int lastID;             /* ID of the last record, damaged or not */
+     int count;              /* records in records */
+     int capacity;           /* room in records */
+     MsgBinRecord_t *records;
+ };
+
+ typedef struct MSG_BIN_CACHE MsgBinCache_t;
+
+ MsgBinCache_t msgBinCache = { 0, 0, 0, 0, FIRST_MESSAGE_INDEX-1, 0, 0, NULL };
+
+ // Lookup table of the CRC of every byte, filled on first use
+ unsigned int crc32cTable[256];
+ int crc32cTableReady = 0;
+
+/**
+ * Continues a CRC-32C over more bytes.
+ *
+ * @param crc the CRC so far (0 to start)
+ * @param data the bytes to add
+ * @param length the number of bytes
+ * @return the CRC including the bytes
+ */
+
+ unsigned int crc32c(unsigned int crc, const void* data, size_t length);
+
+/**
+ * Stores the fields of a record header as MSG_BIN_HEADER_SIZE little-endian bytes.
+ *
+ * @param header the header
+ * @param bytes where to store the bytes
+ */
+
+ void encodeBinHeader(const MsgBinHeader_t* header, unsigned char* bytes);
+
+/**
+ * Reads the fields of a record header from its MSG_BIN_HEADER_SIZE little-endian bytes.
+ *
+ * @param bytes the bytes
+ * @param header where to store the header
+ */
+
+ void decodeBinHeader(const unsigned char* bytes, MsgBinHeader_t* header);
+
+/**
+ * Finds the next intact record after a damaged stretch of the log, so that the
+ * walk can go on behind it.
+ *
+ * @param fd the open binary log
+ * @param from the first byte that may start a record
+ * @param logSize the size of the log
+ * @return the offset of the next intact record, or -1 if there is none
+ */
+
+ long long findNextBinRecord(int fd, long long from, long long logSize);
+
+/**
+ * Builds the record of a message body, ready to be written as one block.
+ *
+ * @param record where to build the record (MSG_BIN_HEADER_SIZE + length bytes)
+ * @param msgID the ID of the message
+ * @param body the message body
+ * @param length the bytes in the body
+ * @return the bytes in the record
+ */
+
+ size_t buildBinRecord(char* record, int msgID, const char* body, size_t length);
+
+/**
+ * Checks a record read from the log: the magic number, the length and the CRC.
+ *
+ * @param record the header followed by (at least) the body
+ * @param available the bytes read
+ * @param header where to store the header
+ * @return 1 if the record is intact, 0 otherwise
+ */
+
+ int checkBinRecord(const char* record, size_t available, MsgBinHeader_t* header);
+
+/**
+ * Brings msgBinCache up to date with the open binary log, walking the records
+ * appended since the last call. A complete record that fails its CRC is skipped
+ * by its length, and a stretch that is no record at all (or a record longer
+ * than the log) up to the next intact record; either counts as one damaged
+ * message. The walk stops at a torn record at the end (fewer bytes left than a
+ * header, or than its header claims, with no intact record after it) and at
+ * damage that no intact record follows.
+ *
+ * @param fd the open binary log
+ * @param logSize where to store the size of the log
+ * @return 1 if successful, 0 otherwise
+ */
+
+ int refreshBinCache(int fd, long long* logSize);
+
+/**
+ * Finds the record of a message in msgBinCache.
+ *
+ * @param msgID the ID of the message
+ * @return the record, or NULL if there is no such message
+ */
+
+ const MsgBinRecord_t* findBinRecord(int msgID);
+
+/**
+ * Adds a record to the end of msgBinCache and counts its ID in msgBinCache.lastID.
+ *
+ * @return 1 if successful, 0 if out of memory
+ */
+
+ int addBinRecord(long long offset, int msgID, unsigned int length);
+
+ unsigned int crc32c(unsigned int crc, const void* data, size_t length)
+ {
+     const unsigned char *bytes = data;
+     size_t i;
+
+     if (!crc32cTableReady)
+     {
+         unsigned int n, bit;
+
+         for (n = 0; n < 256; n++)
+         {
+             unsigned int value = n;
+
+             for (bit = 0; bit < 8; bit++)
+             {
+                 value = (value & 1) ? (value >> 1) ^ CRC32C_POLY : value >> 1;
+             }
+
+             crc32cTable[n] = value;
+         }
+
+         crc32cTableReady = 1;
+     }
+
+     crc = ~crc;
+
+     for (i = 0; i < length; i++)
+     {
+         crc = crc32cTable[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+     }
+
+     return ~crc;
+ }
+
+ void encodeBinHeader(const MsgBinHeader_t* header, unsigned char* bytes)
+ {
+     const unsigned int fields[4] = { header->magic, header->id, header->length, header->crc };
+     int i, b;
+
+     for (i = 0; i < 4; i++)
+     {
+         for (b = 0; b < 4; b++)
+         {
+             bytes[i*4 + b] = (fields[i] >> (8*b)) & 0xff;
+         }
+     }
+ }
+
+ void decodeBinHeader(const unsigned char* bytes, MsgBinHeader_t* header)
+ {
+     unsigned int fields[4] = { 0, 0, 0, 0 };
+     int i, b;
+
+     for (i = 0; i < 4; i++)
+     {
+         for (b = 0; b < 4; b++)
+         {
+             fields[i] |= (unsigned int)bytes[i*4 + b] << (8*b);
+         }
+     }
+
+     header->magic = fields[0];
+     header->id = fields[1];
+     header->length = fields[2];
+     header->crc = fields[3];
+ }
+
+ size_t buildBinRecord(char* record, int msgID, const char* body, size_t length)
+ {
+     MsgBinHeader_t header = { MSG_BIN_MAGIC, (unsigned int)msgID, (unsigned int)length, 0 };
+
+     // The CRC is computed with the CRC field set to 0
+     encodeBinHeader(&header, (unsigned char*)record);
+     header.crc = crc32c(crc32c(0, record, MSG_BIN_HEADER_SIZE), body, length);
+     encodeBinHeader(&header, (unsigned char*)record);
+
+     memcpy(record + MSG_BIN_HEADER_SIZE, body, length);
+
+     return MSG_BIN_HEADER_SIZE + length;
+ }
+
+ int checkBinRecord(const char* record, size_t available, MsgBinHeader_t* header)
+ {
+     unsigned char unsealed[MSG_BIN_HEADER_SIZE];
+
+     if (available < MSG_BIN_HEADER_SIZE)
+     {
+         return 0;
+     }
+
+     decodeBinHeader((const unsigned char*)record, header);
+
+     if (header->magic != MSG_BIN_MAGIC || available - MSG_BIN_HEADER_SIZE < header->length)
+     {
+         return 0;
+     }
+
+     // The CRC was computed with the CRC field set to 0
+     memcpy(unsealed, record, MSG_BIN_HEADER_SIZE);
+     memset(unsealed + 12, 0, 4);
+
+     return crc32c(crc32c(0, unsealed, MSG_BIN_HEADER_SIZE), record + MSG_BIN_HEADER_SIZE, header->length) == header->crc;
+ }
+
+ long long findNextBinRecord(int fd, long long from, long long logSize)
+ {
+     unsigned char magic[MSG_BIN_HEADER_SIZE];
+     char buffer[BIN_SCAN_BYTES];
+     MsgBinHeader_t header = { MSG_BIN_MAGIC, 0, 0, 0 };
+     long long offset = from;
+
+     // The first 4 bytes are the magic number as it is stored
+     encodeBinHeader(&header, magic);
+
+     while (logSize - offset >= MSG_BIN_HEADER_SIZE)
+     {
+         size_t chunk = (logSize - offset < BIN_SCAN_BYTES) ? (size_t)(logSize - offset) : BIN_SCAN_BYTES;
+
+         if (pread(fd, buffer, chunk, offset) != (ssize_t)chunk)
+         {
+             return -1;
+         }
+
+         const char *found = memmem(buffer, chunk, magic, 4);
+
+         if (found == NULL)
+         {
+             // A magic number may straddle two chunks
+             offset += chunk - 3;
+             continue;
+         }
+
+         long long candidate = offset + (found - buffer);
+         char headerBytes[MSG_BIN_HEADER_SIZE];
+
+         if (pread(fd, headerBytes, MSG_BIN_HEADER_SIZE, candidate) == MSG_BIN_HEADER_SIZE)
+         {
+             decodeBinHeader((unsigned char*)headerBytes, &header);
+
+             // A magic number inside a body is not enough: the record must check out
+             if (logSize - candidate - MSG_BIN_HEADER_SIZE >= header.length)
+             {
+                 char *record = malloc(MSG_BIN_HEADER_SIZE + header.length);
+                 int intact = record != NULL &&
+                              pread(fd, record, MSG_BIN_HEADER_SIZE + header.length, candidate) ==
+                                  (ssize_t)(MSG_BIN_HEADER_SIZE + header.length) &&
+                              checkBinRecord(record, MSG_BIN_HEADER_SIZE + header.length, &header);
+
+                 free(record);
+
+                 if (intact)
+                 {
+                     return candidate;
+                 }
+             }
+         }
+
+         offset = candidate + 1;
+     }
+
+     return -1;
+ }
+
+ int refreshBinCache(int fd, long long* logSize)
+ {
+     struct stat logStat;
+     unsigned char headerBytes[MSG_BIN_HEADER_SIZE];
+     MsgBinHeader_t header;
+
+     if (fstat(fd, &logStat) != 0)
+     {
+         return 0;
+     }
+
+     // Start over if this is another file, or if it has lost records
+     if (logStat.st_dev != msgBinCache.device || logStat.st_ino != msgBinCache.inode ||
+         logStat.st_size < msgBinCache.validEnd)
+     {
+         msgBinCache.device = logStat.st_dev;
+         msgBinCache.inode = logStat.st_ino;
+         msgBinCache.validEnd = 0;
+         msgBinCache.lastID = FIRST_MESSAGE_INDEX-1;
+         msgBinCache.count = 0;
+     }
+
+     *logSize = logStat.st_size;
+     msgBinCache.tailDamaged = 0;
+
+     while (*logSize - msgBinCache.validEnd >= MSG_BIN_HEADER_SIZE)
+     {
+         long long left = *logSize - msgBinCache.validEnd - MSG_BIN_HEADER_SIZE;
+
+         if (pread(fd, headerBytes, MSG_BIN_HEADER_SIZE, msgBinCache.validEnd) != MSG_BIN_HEADER_SIZE)
+         {
+             break;
+         }
+
+         decodeBinHeader(headerBytes, &header);
+
+         // Not a record at all, or one that claims more bytes than are left:
+         // go on at the next intact record, if there is one
+         if (header.magic != MSG_BIN_MAGIC || left < header.length)
+         {
+             long long next = findNextBinRecord(fd, msgBinCache.validEnd + 1, *logSize);
+
+             if (next == -1)
+             {
+                 // A record cut short with nothing after it is a torn append,
+                 // the rest of it was never written
+                 msgBinCache.tailDamaged = header.magic != MSG_BIN_MAGIC;
+                 break;
+             }
+
+             if (!addBinRecord(msgBinCache.validEnd, msgBinCache.lastID + 1, 0))
+             {
+                 break;
+             }
+
+             msgBinCache.validEnd = next;
+             continue;
+         }
+
+         // Read the whole record once to check its CRC
+         char *record = malloc(MSG_BIN_HEADER_SIZE + header.length);
+         int intact = record != NULL &&
+                      pread(fd, record, MSG_BIN_HEADER_SIZE + header.length, msgBinCache.validEnd) ==
+                          (ssize_t)(MSG_BIN_HEADER_SIZE + header.length) &&
+                      checkBinRecord(record, MSG_BIN_HEADER_SIZE + header.length, &header);
+
+         free(record);
+
+         // A damaged record keeps its place and its ID (the one after the last),
+         // and the walk goes on after it
+         if (!addBinRecord(msgBinCache.validEnd, intact ? (int)header.id : msgBinCache.lastID + 1, header.length))
+         {
+             break;
+         }
+
+         msgBinCache.validEnd += MSG_BIN_HEADER_SIZE + header.length;
+     }
+
+     return 1;
+ }
+
+ const MsgBinRecord_t* findBinRecord(int msgID)
+ {
+     int i;
+
+     // Messages are normally numbered in sequence, so try the direct position first
+     i = msgID - FIRST_MESSAGE_INDEX;
+
+     if (i >= 0 && i < msgBinCache.count && msgBinCache.records[i].id == msgID)
+     {
+         return &msgBinCache.records[i];
+     }
+
+     for (i = 0; i < msgBinCache.count; i++)
+     {
+         if (msgBinCache.records[i].id == msgID)
+         {
+             return &msgBinCache.records[i];
+         }
+     }
+
+     return NULL;
+ }
+
+ int addBinRecord(long long offset, int msgID, unsigned int length)
+ {
+     if (msgBinCache.count == msgBinCache.capacity)
+     {
+         int capacity = (msgBinCache.capacity > 0) ? msgBinCache.capacity * 2 : 64;
+         MsgBinRecord_t *records = realloc(msgBinCache.records, sizeof(*records) * capacity);
+
+         if (records == NULL)
+         {
+             return 0;
+         }
+
+         msgBinCache.records = records;
+         msgBinCache.capacity = capacity;
+     }
+
+     msgBinCache.records[msgBinCache.count].offset = offset;
+     msgBinCache.records[msgBinCache.count].id = msgID;
+     msgBinCache.records[msgBinCache.count].length = length;
+     msgBinCache.count++;
+
+     if (msgID > msgBinCache.lastID)
+     {
+         msgBinCache.lastID = msgID;
+     }
+
+     return 1;
+ }
+
+ int appendBinMsg(const char *msg)
+ {
+     return appendBinMsgs(&msg, 1) == 1;
+ }
+
+ int appendBinMsgs(const char **msgs, int count)
+ {
+     // The log file is created if it doesn't already exist
+     int fd = open(MSG_BIN_LOG, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+     long long logSize;
+     size_t groupLength = 0;
+     int i;
+
+     if (fd == -1)
+     {
+            perror("Error loading message log");
+            return 0;
+     }
+
+     if (!refreshBinCache(fd, &logSize))
+     {
+         perror("Error loading message log");
+         close(fd);
+         return 0;
+     }
+
+     // Overwrite a torn record instead of appending after it. Other damage at the
+     // end is kept, and counts as a message, as the walk will count it once a
+     // record follows it.
+     if (msgBinCache.tailDamaged)
+     {
+         fprintf(stderr, "The end of the message log is damaged.\n");
+
+         if (!addBinRecord(msgBinCache.validEnd, msgBinCache.lastID + 1, 0))
+         {
+             close(fd);
+             return 0;
+         }
+
+         msgBinCache.validEnd = logSize;
+     }
+     else if (logSize > msgBinCache.validEnd)
+     {
+         fprintf(stderr, "Discarding a torn message at the end of the message log.\n");
+
+         if (ftruncate(fd, msgBinCache.validEnd) != 0)
+         {
+             perror("Error repairing message log");
+             close(fd);
+             return 0;
+         }
+     }
+
+     for (i = 0; i < count; i++)
+     {
+         groupLength += MSG_BIN_HEADER_SIZE + strlen(msgs[i]);
+     }
+
+     int msgID = msgBinCache.lastID + 1;
+     char *group = malloc(groupLength);
+     int appended = 0;
+
+     if (group != NULL)
+     {
+         size_t groupEnd = 0;
+
+         for (i = 0; i < count; i++)
+         {
+             groupEnd += buildBinRecord(group + groupEnd, msgID + i, msgs[i], strlen(msgs[i]));
+         }
+
+         // The whole group goes out in one write and is synced once
+         if (pwrite(fd, group, groupLength, msgBinCache.validEnd) == (ssize_t)groupLength)
+         {
+             // The records are in the log now, so they must not be posted
+             // again even if they may not have reached the disk
+             if (fsync(fd) != 0)
+             {
+                 perror("Error syncing message log");
+             }
+
+             for (i = 0; i < count; i++)
+             {
+                 size_t length = strlen(msgs[i]);
+
+                 if (!addBinRecord(msgBinCache.validEnd, msgID + i, length))
+                 {
+                     break;
+                 }
+
+                 msgBinCache.validEnd += MSG_BIN_HEADER_SIZE + length;
+             }
+
+             appended = count;
+         }
+         else
+         {
+             fprintf(stderr, "Unable to write in new messages.\n");
+
+             // Take back the part that was written, so that none of the
+             // records is left in the log
+             if (ftruncate(fd, msgBinCache.validEnd) != 0)
+             {
+                 perror("Error repairing message log");
+             }
+         }
+
+         free(group);
+     }
+
+     close(fd);
+
+     return appended;
+ }
+
+
+ int readBinMessageByID(int match, FILE *outputStream)
+ {
+     int fd = open(MSG_BIN_LOG, O_RDONLY | O_CLOEXEC);
+     long long logSize;
+     MsgBinHeader_t header;
+
+     if (fd == -1)
+     {
+            perror("Error loading message log");
+            return 0;
+     }
+
+     const MsgBinRecord_t *found = refreshBinCache(fd, &logSize) ? findBinRecord(match) : NULL;
+
+     if (found == NULL)
+     {
+         fprintf(stderr, "Message %d not found.\n", match);
+         close(fd);
+         return 0;
+     }
+
+     // The header and body are read together and checked again, as the record
+     // may have been damaged since it was walked
+     size_t recordLength = MSG_BIN_HEADER_SIZE + found->length;
+     char *record = malloc(recordLength);
+     int success = record != NULL &&
+                   pread(fd, record, recordLength, found->offset) == (ssize_t)recordLength &&
+                   checkBinRecord(record, recordLength, &header);
+
+     close(fd);
+
+     if (success)
+     {
+         fwrite(record + MSG_BIN_HEADER_SIZE, 1, header.length, outputStream);
+
+         // Add an extra new line if the message body was empty
+         if (header.length == 0)
+         {
+             fputc('\n', outputStream);
+         }
+     }
+     else
+     {
+         fprintf(stderr, "Message %d is damaged.\n", match);
+     }
+
+     free(record);
+
+     return success;
+ }
+
+ int getBinMessageCount()
+ {
+     int fd = open(MSG_BIN_LOG, O_RDONLY | O_CLOEXEC);
+     long long logSize;
+     int lastMessage = FIRST_MESSAGE_INDEX-1;
+
+     if (fd == -1)
+     {
+            perror("Error loading message log");
+            return lastMessage;
+     }
+
+     if (refreshBinCache(fd, &logSize))
+     {
+         lastMessage = msgBinCache.lastID;
+     }
+
+     close(fd);
+
+     return lastMessage;
+ }
+
+ int convertToBinaryLog()
+ {
+     int fd = open(MSG_BIN_LOG".tmp", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+     int lastMessage = getMessageCount();
+     int converted = 0;
+     int msgID;
+
+     if (fd == -1)
+     {
+         perror("Error creating message log");
+         return -1;
+     }
+
+     for (msgID = FIRST_MESSAGE_INDEX; msgID <= lastMessage && converted != -1; msgID++)
+     {
+         MsgSpan_t body;
+         int found = findMessageSpan(msgID, &body);
+         size_t recordLength;
+
+         // Messages missing from the text log are left out
+         if (found == 0)
+         {
+             continue;
+         }
+
+         char *record = (found == 1) ? malloc(MSG_BIN_HEADER_SIZE + body.length) : NULL;
+
+         if (record != NULL)
+         {
+             recordLength = buildBinRecord(record, msgID, body.start, body.length);
+         }
+
+         if (record != NULL && write(fd, record, recordLength) == (ssize_t)recordLength)
+         {
+             converted++;
+         }
+         else
+         {
+             converted = -1;
+         }
+
+         free(record);
+     }
+
+     if (close(fd) != 0 || converted == -1 || rename(MSG_BIN_LOG".tmp", MSG_BIN_LOG) != 0)
+     {
+         perror("Error writing message log");
+         remove(MSG_BIN_LOG".tmp");
+         return -1;
+     }
+
+     return converted;
+ }
+
+ int convertToTextLog()
+ {
+     int fd = open(MSG_BIN_LOG, O_RDONLY | O_CLOEXEC);
+     long long logSize;
+     int converted = 0;
+     int i;
+
+     if (fd == -1)
+     {
+         perror("Error loading message log");
+         return -1;
+     }
+
+     FILE *textLog = fopen(MSG_LOG".tmp", "wb");
+
+     if (textLog == NULL || !refreshBinCache(fd, &logSize))
+     {
+         perror("Error creating message log");
+         close(fd);
+
+         if (textLog != NULL)
+         {
+             fclose(textLog);
+             remove(MSG_LOG".tmp");
+         }
+
+         return -1;
+     }
+
+     for (i = 0; i < msgBinCache.count && converted != -1; i++)
+     {
+         const MsgBinRecord_t *found = &msgBinCache.records[i];
+         size_t recordLength = MSG_BIN_HEADER_SIZE + found->length;
+         char *record = malloc(recordLength);
+         MsgBinHeader_t header;
+
+         if (record == NULL || pread(fd, record, recordLength, found->offset) != (ssize_t)recordLength ||
+             !checkBinRecord(record, recordLength, &header))
+         {
+             fprintf(stderr, "Message %d is damaged.\n", found->id);
+             converted = -1;
+         }
+         else if (memmem(record + MSG_BIN_HEADER_SIZE, header.length,
+                         CLOSING_XML_TAG_FORMAT, strlen(CLOSING_XML_TAG_FORMAT)) != NULL)
+         {
+             fprintf(stderr, "Message %d contains the closing tag "CLOSING_XML_TAG_FORMAT".\n", found->id);
+             converted = -1;
+         }
+         else
+         {
+             const char *body = record + MSG_BIN_HEADER_SIZE;
+
+             fprintf(textLog, OPENING_XML_TAG_FORMAT"\n", found->id);
+             fwrite(body, 1, header.length, textLog);
+
+             // Add a trailing newline if there isn't one in the message
+             if (header.length != 0 && body[header.length-1] != '\n')
+             {
+                 fputc('\n', textLog);
+             }
+
+             fprintf(textLog, CLOSING_XML_TAG_FORMAT"\n");
+             converted++;
+         }
+
+         free(record);
+     }
+
+     close(fd);
+
+     if (fclose(textLog) != 0 || converted == -1 || rename(MSG_LOG".tmp", MSG_LOG) != 0)
+     {
+         if (converted != -1)
+         {
+             perror("Error writing message log");
+         }
+
+         remove(MSG_LOG".tmp");
+         return -1;
+     }
+
+     // The index described the old log
+     remove(MSG_INDEX);
+
+     return converted;
+ }
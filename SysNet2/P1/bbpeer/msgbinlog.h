@@ -0,0 +1,113 @@
+/**
+ * File:   msgbinlog.h
+ *
+ * msgbinlog keeps the messages of the bulletin board in a binary log, an
+ * alternative to the text log of msgparser. Build with -DBINARY_LOG=1 to have
+ * the terminal commands use it. Messages are numbered the same way (starting
+ * at FIRST_MESSAGE_INDEX) but are stored as records instead of tagged text, so
+ * nothing has to be parsed and a body may contain any bytes, including the tags
+ * of the text format.
+ *
+ * RECORD:
+ *      HEADER: magic, message ID, body length and CRC-32C, each a 4-byte unsigned
+ *              int in little-endian byte order (MSG_BIN_HEADER_SIZE bytes in all),
+ *              so a log can be read on any host
+ *      BODY:   the raw message body (length bytes, not null-terminated)
+ *
+ * The CRC covers the header (with the CRC field set to 0) and the body. A record
+ * is appended with a single write and read back with a single pread. A record at
+ * the end with fewer bytes than its header claims (or less than a header) was
+ * torn by an interrupted append; the log ends before it, and the next append
+ * overwrites it. A complete record whose CRC does not match was damaged later:
+ * it is skipped by its length and still counts as a message, so its ID is never
+ * handed out again. Bytes that are not a record at all are skipped up to the next
+ * intact record and count as one message too. Reading a damaged message fails.
+ *
+ * The offsets of the records are kept in memory after the log has been walked
+ * once, so later calls only walk records appended since.
+ *
+ * @author Luke Kledzik
+ * @author Adam Mooers
+ * @date 2/13/2017
+ * @info Course COP4635
+ */
+
+#ifndef MSGBINLOG_H
+#define MSGBINLOG_H
+
+#include <stdio.h>
+
+// Use the binary log in the terminal commands (set with -DBINARY_LOG=1)
+#ifndef BINARY_LOG
+#define BINARY_LOG 0
+#endif
+
+#define MSG_BIN_LOG "messages.bin"
+#define MSG_BIN_MAGIC 0x4742534d
+#define MSG_BIN_HEADER_SIZE 16
+
+ /**
+  * Appends a message to the end of the binary log. The message is given an ID
+  * one greater than the ID of the last message. Error codes are printed to stderr.
+  *
+  * @param msg pointer to null-terminated string containing the message to append.
+  * @return 1 if successful, 0 otherwise
+  */
+
+ int appendBinMsg(const char *msg);
+
+ /**
+  * Appends several messages to the binary log as one group commit: all of their
+  * records are written with a single write and made durable with a single fsync.
+  * The messages are given consecutive IDs in the order given. A failed write is
+  * taken back, so that either all of the messages are in the log or none is; a
+  * failed fsync is only reported, as the messages are in the log by then.
+  *
+  * @param msgs the null-terminated strings containing the messages to append
+  * @param count the number of messages
+  * @return the number of messages appended (count if they were written, 0 otherwise)
+  */
+
+ int appendBinMsgs(const char **msgs, int count);
+
+ /**
+  * Prints the body of a message in the binary log to the given stream, followed
+  * by a newline if the body is empty (like readMessageByID). Error codes are
+  * printed to stderr.
+  *
+  * @param match the ID the message to find and print
+  * @param outputStream the stream to print the message body to
+  * @return 1 if successful, 0 otherwise
+  */
+
+ int readBinMessageByID(int match, FILE *outputStream);
+
+ /**
+  * Returns the ID of the last message in the binary log.
+  *
+  * @return the ID of the last message or FIRST_MESSAGE_INDEX-1 if there are none
+  */
+
+ int getBinMessageCount();
+
+ /**
+  * Writes every message of the text log (MSG_LOG) to a new binary log, which
+  * replaces MSG_BIN_LOG. The messages keep their IDs.
+  *
+  * @return the number of messages converted, or -1 if unsuccessful
+  */
+
+ int convertToBinaryLog();
+
+ /**
+  * Writes every message of the binary log (MSG_BIN_LOG) to a new text log, which
+  * replaces MSG_LOG. The messages keep their IDs. Bodies without a trailing
+  * newline are given one. A body that contains the closing tag of the text
+  * format cannot be converted, and the text log is then left as it was.
+  *
+  * @return the number of messages converted, or -1 if unsuccessful
+  */
+
+ int convertToTextLog();
+
+ #endif
@@ -0,0 +1,47 @@
+/**
+ * File:   msgconvert.c
+ *
+ * Converts the message log between the text format of msgparser (MSG_LOG) and
+ * the binary format of msgbinlog (MSG_BIN_LOG). Run it in the directory of the
+ * logs, while no peer is running.
+ *
+ * Usage: msgconvert tobinary|totext
+ *
+ * @author Luke Kledzik
+ * @author Adam Mooers
+ * @date 2/13/2017
+ * @info Course COP4635
+ */
+
+ #include <stdio.h>
+ #include <string.h>
+ #include "msgparser.h"
+ #include "msgbinlog.h"
+
+ int main(int argc, char** argv)
+ {
+     int converted;
+
+     if (argc == 2 && strcmp(argv[1], "tobinary") == 0)
+     {
+         converted = convertToBinaryLog();
+     }
+     else if (argc == 2 && strcmp(argv[1], "totext") == 0)
+     {
+         converted = convertToTextLog();
+     }
+     else
+     {
+         fprintf(stderr, "Usage: %s tobinary|totext\n", argv[0]);
+         return 1;
+     }
+
+     if (converted == -1)
+     {
+         fprintf(stderr, "The message log was not converted.\n");
+         return 1;
+     }
+
+     printf("Converted %d messages.\n", converted);
+     return 0;
+ }
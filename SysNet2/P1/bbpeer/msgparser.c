@@ -9,9 +9,90 @@
  * @info Course COP4635
  */
  
+ #define _GNU_SOURCE
+ #include <stdlib.h>
  #include <string.h>
+ #include <errno.h>
+ #include <limits.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/mman.h>
+ #include <sys/sendfile.h>
+ #include <sys/uio.h>
+ #include <sys/stat.h>
  #include "msgparser.h"
  
+ // Identifies an index file (the bytes "MIDX" on a little-endian machine)
+ #define MSG_INDEX_MAGIC 0x5844494d
+ 
+ // Longest opening tag that is parsed (the rest of a longer line is ignored)
+ #define MAX_OPENING_TAG_LEN 32
+ 
+ // Largest piece of the mapped log written at a time when sendfile cannot be used
+ #define MAP_WRITE_BYTES (64*1024)
+ 
+ /**
+  * The header at the start of the MSG_INDEX file. The size and modification
+  * time of MSG_LOG are recorded so that an index that no longer describes the
+  * log (e.g. a peer without index support appended to it) is detected.
+  */
+ struct MSG_INDEX_HEADER
+ {
+     unsigned int magic;     /* MSG_INDEX_MAGIC */
+     int count;              /* messages in the log, also the last ID */
+     long long logSize;      /* size of MSG_LOG in bytes */
+     long long logMtime;     /* modification time of MSG_LOG in nanoseconds */
+ };
+ 
+ typedef struct MSG_INDEX_HEADER MsgIndexHeader_t;
+ 
+ /**
+  * One entry of the MSG_INDEX file. Entry i describes message FIRST_MESSAGE_INDEX+i.
+  */
+ struct MSG_INDEX_ENTRY
+ {
+     long long offset;       /* first byte of the message body in MSG_LOG */
+     long long length;       /* bytes in the body, up to the closing tag line */
+ };
+ 
+ typedef struct MSG_INDEX_ENTRY MsgIndexEntry_t;
+ 
+ /**
+  * The message log mapped into memory. The mapping is kept between calls and
+  * only replaced when the log changes size or is replaced by another file, so
+  * the spans handed out by findMessageSpan stay valid until then. The mapping is
+  * shared: if another process truncates the log in place, reading the pages past
+  * its new end raises SIGBUS, so msgLogMapHolds is checked before a span is read.
+  */
+ struct MSG_LOG_MAP
+ {
+     int fd;                 /* the mapped log, or -1 */
+     dev_t device;           /* identity of the mapped file */
+     ino_t inode;
+     char *base;             /* first byte of the mapping, NULL if empty */
+     size_t length;          /* bytes mapped (the size of the log) */
+ };
+ 
+ typedef struct MSG_LOG_MAP MsgLogMap_t;
+ 
+ MsgLogMap_t msgLogMap = { -1, 0, 0, NULL, 0 };
+ 
+ /**
+  * The last message ID of a log that cannot be indexed, remembered after it has
+  * been scanned for. It is used while the size and modification time of the log
+  * still match (the index header plays this part for indexable logs).
+  */
+ struct MSG_LOG_TAIL
+ {
+     long long logSize;      /* size of MSG_LOG in bytes, -1 if unknown */
+     long long logMtime;     /* modification time of MSG_LOG in nanoseconds */
+     int lastID;             /* ID of the last message */
+ };
+ 
+ typedef struct MSG_LOG_TAIL MsgLogTail_t;
+ 
+ MsgLogTail_t msgLogTail = { -1, 0, FIRST_MESSAGE_INDEX-1 };
+ 
 /**
  * Scans the file until a given character is reached. The filestream
  * points to the character following the first match after the intial
@@ -48,6 +129,138 @@
  */
  
  void addNewLineIfNone(FILE* fp);
+ 
+/**
+ * Reads the size and modification time of the message log.
+ * 
+ * @param msgLog the open message log (pending writes are flushed first)
+ * @param logSize where to store the size in bytes
+ * @param logMtime where to store the modification time in nanoseconds
+ * @return 1 if successful, 0 otherwise
+ */
+ 
+ int statMsgLog(FILE* msgLog, long long* logSize, long long* logMtime);
+ 
+/**
+ * Opens MSG_INDEX and checks that it describes the message log as it is now.
+ * A missing or stale index is rebuilt from the log with a single scan.
+ * 
+ * @param msgLog the open message log
+ * @param header where to store the index header
+ * @return the open index file, or NULL if the log cannot be indexed (the
+ *         caller should fall back to scanning the log)
+ */
+ 
+ FILE* loadMsgIndex(FILE* msgLog, MsgIndexHeader_t* header);
+ 
+/**
+ * Finds the ID of the last message without scanning the log when possible: it is
+ * read from the index header, or from msgLogTail if the log cannot be indexed and
+ * has not changed since it was last scanned.
+ * 
+ * @param msgLog the open message log
+ * @param index the open index, or NULL if the log cannot be indexed
+ * @param header the index header (unused if index is NULL)
+ * @return the ID of the last message, or FIRST_MESSAGE_INDEX-1 if there are none
+ */
+ 
+ int findLastMessageID(FILE* msgLog, FILE* index, const MsgIndexHeader_t* header);
+ 
+/**
+ * Writes a list of buffers to a file with as few writev calls as possible,
+ * continuing after partial writes.
+ * 
+ * @param fd the file to write to
+ * @param iov the buffers (updated as they are written)
+ * @param iovCount the number of buffers
+ * @return 1 if everything was written, 0 otherwise
+ */
+ 
+ int writeAllVectors(int fd, struct iovec* iov, int iovCount);
+ 
+/**
+ * Sends part of the mapped message log to a file descriptor. sendfile is used so
+ * the bytes go from the page cache to fd without a copy through msgparser; if fd
+ * cannot take sendfile, the bytes are written from the mapping instead.
+ * 
+ * @param fd the file descriptor to send to
+ * @param start the first byte to send
+ * @param end one past the last byte to send
+ * @return 1 if successful, 0 otherwise
+ */
+ 
+ int sendLogRange(int fd, long long start, long long end);
+ 
+/**
+ * Scans the whole message log and writes a new MSG_INDEX for it. The index is
+ * written to a temporary file of its own (mkstemp) first and renamed over the
+ * old one, so readers never see half an index, and peers rebuilding it at the
+ * same time do not write into each other's file. Only logs whose messages are numbered
+ * FIRST_MESSAGE_INDEX, FIRST_MESSAGE_INDEX+1, ... and all closed can be indexed.
+ * 
+ * @param msgLog the open message log
+ * @param header where to store the new index header
+ * @return the open index file, or NULL if the log cannot be indexed
+ */
+ 
+ FILE* rebuildMsgIndex(FILE* msgLog, MsgIndexHeader_t* header);
+ 
+/**
+ * Looks up the offset and length of a message body in the index.
+ * 
+ * @param index the open index file
+ * @param header the index header
+ * @param msgID the id of the message
+ * @param entry where to store the entry
+ * @return 1 if the message exists, 0 otherwise
+ */
+ 
+ int readMsgIndexEntry(FILE* index, const MsgIndexHeader_t* header, int msgID, MsgIndexEntry_t* entry);
+ 
+/**
+ * Maps MSG_LOG into memory, or brings the existing mapping up to date if the
+ * log has grown (or changed) since it was mapped.
+ * 
+ * @param log where to store the first byte of the log (NULL if it is empty)
+ * @param length where to store the size of the log
+ * @return 1 if successful, 0 if the log cannot be mapped
+ */
+ 
+ int mapMsgLog(const char** log, size_t* length);
+ 
+/**
+ * Checks with fstat that the mapped log still holds its first end bytes, so they
+ * can be read without SIGBUS even if the log was truncated since it was mapped.
+ * 
+ * @param end the number of bytes from the start of the mapping that will be read
+ * @return 1 if the log is still at least end bytes long, 0 otherwise
+ */
+ 
+ int msgLogMapHolds(size_t end);
+ 
+/**
+ * Finds the next message in the mapped log, looking at lines with memchr rather
+ * than reading characters. Like searchLogByID, an opening tag at the start of a
+ * line starts a message, and the body ends at the start of the first line that
+ * holds the closing tag.
+ * 
+ * @param log the mapped log
+ * @param length the size of the log
+ * @param pos where to start (a line start); moved past the message found
+ * @param msgID where to store the ID of the message
+ * @param body where to store the message body
+ * @return 1 if a message was found, 2 if it was found but never closed (the body
+ *         runs to the end of the log), 0 if there are no more messages
+ */
+ 
+ int nextMappedMessage(const char* log, size_t length, size_t* pos, int* msgID, MsgSpan_t* body);
+ 
+/**
+ * The stdio reader used when the log cannot be mapped: scans for the message
+ * and prints its body a line at a time. See readMessageByID.
+ */
+ 
+ int readMessageByScan(int match, FILE* outputStream);
   
   // Buffer for storing incoming lines of the message log. Note the maximum line length
   // including the new line and the null-terminating character
@@ -121,6 +334,104 @@
  }
  
  int readMessageByID(int match, FILE* outputStream)
+ {
+     MsgSpan_t body;
+     int found = findMessageSpan(match, &body);
+     
+     // The body is printed straight from the mapped log, unless the log shrank since
+     if (found == 1 && msgLogMapHolds(body.start - msgLogMap.base + body.length))
+     {
+         fwrite(body.start, 1, body.length, outputStream);
+         
+         // Add an extra new line if the message body was empty
+         if (body.length == 0)
+         {
+             fputc('\n', outputStream);
+         }
+         
+         return 1;
+     }
+     
+     if (found == 0)
+     {
+         fprintf(stderr, "Message %d not found.\n", match);
+         return 0;
+     }
+     
+     // The log could not be mapped (or changed under the mapping)
+     return readMessageByScan(match, outputStream);
+ }
+ 
+ int findMessageSpan(int msgID, MsgSpan_t* span)
+ {
+     const char *log;
+     size_t logLength;
+     FILE *msgLog = fopen(MSG_LOG, "rb");
+     
+     if (msgLog == NULL)
+     {
+            perror("Error loading message log");
+            return -1;
+     }
+     
+     // Look the message up in the index rather than scanning the log. The index
+     // is loaded first, as rebuilding it maps the log again, which may replace
+     // a mapping taken before (see exportMessages).
+     MsgIndexHeader_t header;
+     FILE *index = loadMsgIndex(msgLog, &header);
+     
+     fclose(msgLog);
+     
+     if (!mapMsgLog(&log, &logLength))
+     {
+         if (index != NULL)
+         {
+             fclose(index);
+         }
+         
+         return -1;
+     }
+     
+     // The index describes the log as it was when it was loaded
+     if (index != NULL && (long long)logLength != header.logSize)
+     {
+         fclose(index);
+         index = NULL;
+     }
+     
+     if (index != NULL)
+     {
+         MsgIndexEntry_t entry;
+         int found = readMsgIndexEntry(index, &header, msgID, &entry) &&
+                     entry.offset + entry.length <= (long long)logLength;
+         
+         fclose(index);
+         
+         if (found)
+         {
+             span->start = log + entry.offset;
+             span->length = entry.length;
+         }
+         
+         return found;
+     }
+     
+     // Unindexable log: scan the mapping for the message
+     size_t pos = 0;
+     int curID, result;
+     
+     while ((result = nextMappedMessage(log, logLength, &pos, &curID, span)) != 0)
+     {
+         if (curID == msgID)
+         {
+             return result == 1;
+         }
+     }
+     
+     return 0;
+ }
+ 
+ int readMessageByScan(int match, FILE* outputStream)
  {
      // Open the message log for reading
      FILE *msgLog = fopen(MSG_LOG, "rb");
@@ -200,8 +511,256 @@
             return 0;
      }
      
-     // Search for a nonexistent message ID to find the last id in the file
-     int lastMessage = searchLogByID(msgLog, FIRST_MESSAGE_INDEX-1);
+     // The index header holds the count
+     MsgIndexHeader_t header;
+     FILE *index = loadMsgIndex(msgLog, &header);
+     int lastMessage = findLastMessageID(msgLog, index, &header);
+     
+     if (index != NULL)
+     {
+         fclose(index);
+     }
+     
+     fclose(msgLog);
+     
+     return lastMessage;
+ }
+ 
+ int findLastMessageID(FILE* msgLog, FILE* index, const MsgIndexHeader_t* header)
+ {
+     long long logSize, logMtime;
+     
+     if (index != NULL)
+     {
+         return header->count;
+     }
+     
+     if (!statMsgLog(msgLog, &logSize, &logMtime))
+     {
+         return scanMessageLog(SCAN_MMAP);
+     }
+     
+     // Scan only if the log has changed since the last scan
+     if (logSize != msgLogTail.logSize || logMtime != msgLogTail.logMtime)
+     {
+         msgLogTail.lastID = scanMessageLog(SCAN_MMAP);
+         msgLogTail.logSize = logSize;
+         msgLogTail.logMtime = logMtime;
+     }
+     
+     return msgLogTail.lastID;
+ }
+ 
+ int exportMessages(int first, int last, int fd)
+ {
+     const char *log;
+     size_t logLength;
+     long long start = -1, end = -1;
+     int exported = 0;
+     FILE *msgLog = fopen(MSG_LOG, "rb");
+     
+     if (msgLog == NULL)
+     {
+            perror("Error loading message log");
+            return -1;
+     }
+     
+     // Load the index first: rebuilding it maps the log again, which may replace
+     // a mapping taken before
+     MsgIndexHeader_t header;
+     FILE *index = loadMsgIndex(msgLog, &header);
+     
+     fclose(msgLog);
+     
+     if (!mapMsgLog(&log, &logLength))
+     {
+         perror("Error loading message log");
+         
+         if (index != NULL)
+         {
+             fclose(index);
+         }
+         
+         return -1;
+     }
+     
+     // The index describes the log as it was when it was loaded
+     if (index != NULL && (long long)logLength != header.logSize)
+     {
+         fclose(index);
+         index = NULL;
+     }
+     
+     if (index != NULL)
+     {
+         MsgIndexEntry_t firstEntry, lastEntry;
+         int firstID = (first > FIRST_MESSAGE_INDEX) ? first : FIRST_MESSAGE_INDEX;
+         int lastID = (last < FIRST_MESSAGE_INDEX-1 + header.count) ? last : FIRST_MESSAGE_INDEX-1 + header.count;
+         
+         // Only the two ends of the range are looked up: the messages between
+         // them are consecutive in the log
+         if (firstID <= lastID && readMsgIndexEntry(index, &header, firstID, &firstEntry) &&
+             readMsgIndexEntry(index, &header, lastID, &lastEntry))
+         {
+             start = firstEntry.offset;
+             end = lastEntry.offset + lastEntry.length;
+             exported = lastID - firstID + 1;
+         }
+         
+         fclose(index);
+     }
+     else
+     {
+         // Unindexable log: find the ends of the range in one pass
+         MsgSpan_t body;
+         size_t pos = 0;
+         int curID;
+         int firstID = (first > FIRST_MESSAGE_INDEX) ? first : FIRST_MESSAGE_INDEX;
+         
+         while (nextMappedMessage(log, logLength, &pos, &curID, &body) != 0)
+         {
+             if (curID >= firstID && curID <= last)
+             {
+                 if (start == -1)
+                 {
+                     start = body.start - log;
+                 }
+                 
+                 end = body.start - log + body.length;
+                 exported++;
+             }
+         }
+     }
+     
+     if (exported == 0)
+     {
+         fprintf(stderr, "No messages in the range %d-%d.\n", first, last);
+         return 0;
+     }
+     
+     // The widening below may look at every byte of the mapping
+     if (!msgLogMapHolds(logLength))
+     {
+         fprintf(stderr, "The message log changed while it was exported.\n");
+         return -1;
+     }
+     
+     // Widen the range from the first body to the start of its header line, and
+     // from the last body to the end of its footer line
+     const char *lineEnd = (start > 0) ? memrchr(log, '\n', start - 1) : NULL;
+     start = (lineEnd != NULL) ? lineEnd + 1 - log : 0;
+     
+     lineEnd = memchr(log + end, '\n', logLength - end);
+     end = (lineEnd != NULL) ? lineEnd + 1 - log : (long long)logLength;
+     
+     if (!sendLogRange(fd, start, end))
+     {
+         perror("Error exporting messages");
+         return -1;
+     }
+     
+     return exported;
+ }
+ 
+ int sendLogRange(int fd, long long start, long long end)
+ {
+     off_t offset = start;
+     
+     while (offset < end)
+     {
+         ssize_t sent = sendfile(fd, msgLogMap.fd, &offset, end - offset);
+         
+         if (sent > 0 || (sent == -1 && errno == EINTR))
+         {
+             continue;
+         }
+         
+         // The log ended early, or fd cannot take sendfile
+         if (sent == 0 || (errno != EINVAL && errno != ENOSYS))
+         {
+             return 0;
+         }
+         
+         break;
+     }
+     
+     while (offset < end)
+     {
+         size_t chunk = (end - offset < MAP_WRITE_BYTES) ? (size_t)(end - offset) : MAP_WRITE_BYTES;
+         
+         // A slow fd gives other processes time to truncate the log
+         if (!msgLogMapHolds(offset + chunk))
+         {
+             errno = EIO;
+             return 0;
+         }
+         
+         ssize_t written = write(fd, msgLogMap.base + offset, chunk);
+         
+         if (written == -1 && errno != EINTR)
+         {
+             return 0;
+         }
+         
+         offset += (written > 0) ? written : 0;
+     }
+     
+     return 1;
+ }
+ 
+ int scanMessageLog(int method)
+ {
+     const char *log;
+     size_t logLength;
+     
+     if (method == SCAN_MMAP && mapMsgLog(&log, &logLength))
+     {
+         MsgSpan_t body;
+         size_t pos = 0;
+         int curID;
+         int lastMessage = FIRST_MESSAGE_INDEX-1;
+         
+         while (nextMappedMessage(log, logLength, &pos, &curID, &body) != 0)
+         {
+             lastMessage = curID;
+         }
+         
+         return lastMessage;
+     }
+     
+     // Open the message log for reading
+     FILE *msgLog = fopen(MSG_LOG, "rb");
+     
+     if (msgLog == NULL)
+     {
+            perror("Error loading message log");
+            return FIRST_MESSAGE_INDEX-1;
+     }
+     
+     // Follow the same rules as nextMappedMessage: an opening tag only starts a
+     // message outside of a body, and the body runs to the closing tag
+     const size_t tagLen = strlen(CLOSING_XML_TAG_FORMAT);
+     int lastMessage = FIRST_MESSAGE_INDEX-1;
+     int inBody = 0;
+     char *line = NULL;
+     size_t lineCapacity = 0;
+     ssize_t lineLen;
+     int curID;
+     
+     while ((lineLen = getline(&line, &lineCapacity, msgLog)) != -1)
+     {
+         if (inBody)
+         {
+             inBody = memmem(line, lineLen, CLOSING_XML_TAG_FORMAT, tagLen) == NULL;
+         }
+         else if (line[0] == '<' && sscanf(line, OPENING_XML_TAG_FORMAT, &curID) == 1)
+         {
+             lastMessage = curID;
+             inBody = 1;
+         }
+     }
+     
+     free(line);
      
      // Close the message log
      fclose(msgLog);
@@ -210,6 +769,11 @@
  }
  
  int appendMsg(const char *msg)
+ {
+     return appendMsgs(&msg, 1) == 1;
+ }
+ 
+ int appendMsgs(const char **msgs, int count)
  {
      // Open the message log for appending and reading
      // The log file is created if it doesn't already exist
@@ -221,8 +785,14 @@
             return 0;
      }
      
-     // Search for a nonexistent message ID to find the last id in the file
-     int msgCount = searchLogByID(msgLog, FIRST_MESSAGE_INDEX-1);
+     // Open the index while it still matches the log, so that it can be
+     // brought up to date after the append instead of rebuilt
+     MsgIndexHeader_t header;
+     FILE *index = loadMsgIndex(msgLog, &header);
+     
+     // The last id comes from the index header (or the remembered tail), so
+     // the log is not scanned
+     int msgCount = findLastMessageID(msgLog, index, &header);
      
      // Seek to the end of the file
      fseek(msgLog, 0L, SEEK_END);
@@ -230,43 +800,161 @@
      // If the file was available and not corrupted
      if (msgCount > FIRST_MESSAGE_INDEX-1 || ftell(msgLog) == 0L)
      {
-        
         addNewLineIfNone(msgLog);
+        fflush(msgLog);
+        
+        long long start = ftell(msgLog);
+        long long tail = start;
         
-        // If file successfully opened...
-        if (msgLog != NULL)
+        // Each message is written as its header, body, a newline if the body
+        // lacks one, and footer
+        struct iovec *iov = malloc(sizeof(*iov) * 4 * count);
+        char (*headers)[MAX_OPENING_TAG_LEN] = malloc(sizeof(*headers) * count);
+        MsgIndexEntry_t *entries = malloc(sizeof(*entries) * count);
+        int iovCount = 0;
+        int appended = 0;
+        int i;
+        
+        if (iov != NULL && headers != NULL && entries != NULL)
         {
-            int msgBodyLen = strlen(msg);
-            
-            // Write header (assume previous line ends with newline)
-            fprintf(msgLog, OPENING_XML_TAG_FORMAT"\n", msgCount+1);
-            
-            // Write message body
-            fputs(msg, msgLog);
+            for (i = 0; i < count; i++)
+            {
+                int msgBodyLen = strlen(msgs[i]);
+                int headerLen = snprintf(headers[i], sizeof(headers[i]), OPENING_XML_TAG_FORMAT"\n", msgCount+1+i);
+                
+                iov[iovCount].iov_base = headers[i];
+                iov[iovCount++].iov_len = headerLen;
+                iov[iovCount].iov_base = (void*)msgs[i];
+                iov[iovCount++].iov_len = msgBodyLen;
+                
+                entries[i].offset = tail + headerLen;
+                entries[i].length = msgBodyLen;
+                
+                // Add a trailing newline if there isn't one in the message
+                if (msgBodyLen != 0 && msgs[i][msgBodyLen-1] != '\n')
+                {
+                    iov[iovCount].iov_base = "\n";
+                    iov[iovCount++].iov_len = 1;
+                    entries[i].length++;
+                }
+                
+                iov[iovCount].iov_base = CLOSING_XML_TAG_FORMAT"\n";
+                iov[iovCount++].iov_len = strlen(CLOSING_XML_TAG_FORMAT"\n");
+                
+                tail = entries[i].offset + entries[i].length + strlen(CLOSING_XML_TAG_FORMAT"\n");
+            }
             
-            // Add a trailing newline if there isn't one in the message
-            if(msgBodyLen != 0 && msg[msgBodyLen-1] != '\n')
+            // Commit the whole group with one write and one sync
+            if (writeAllVectors(fileno(msgLog), iov, iovCount))
             {
-                fputc('\n', msgLog);
+                // The messages are in the log now, so they must not be posted
+                // again even if they may not have reached the disk
+                appended = count;
+                
+                if (fsync(fileno(msgLog)) != 0)
+                {
+                    perror("Error syncing message log");
+                }
             }
+            else
+            {
+                perror("Error writing message log");
+                
+                // Take back the part that was written, so that none of the
+                // messages is left in the log
+                if (ftruncate(fileno(msgLog), start) != 0)
+                {
+                    perror("Error repairing message log");
+                }
+            }
+        }
+        else
+        {
+            fprintf(stderr, "Out of memory: Unable to write in new messages.\n");
+        }
+        
+        // Add the messages to the index. A failure leaves the index stale,
+        // so it is rebuilt by the next reader.
+        if (appended > 0 && index != NULL && header.count == msgCount)
+        {
+            header.count += appended;
             
-            // Write footer
-            fprintf(msgLog, CLOSING_XML_TAG_FORMAT"\n");
+            if (statMsgLog(msgLog, &header.logSize, &header.logMtime))
+            {
+                fseek(index, sizeof(header) + (long)sizeof(*entries)*(msgCount+1-FIRST_MESSAGE_INDEX), SEEK_SET);
+                fwrite(entries, sizeof(*entries), appended, index);
+                rewind(index);
+                fwrite(&header, sizeof(header), 1, index);
+            }
+        }
+        else if (appended > 0 && index == NULL && statMsgLog(msgLog, &msgLogTail.logSize, &msgLogTail.logMtime))
+        {
+            msgLogTail.lastID = msgCount + appended;
+        }
+        
+        free(iov);
+        free(headers);
+        free(entries);
+        
+        if (index != NULL)
+        {
+            fclose(index);
         }
              
         // Close the message log
         fclose(msgLog);
         
-        // Report success
-        return 1;
+        return appended;
      }
      else
      {
          fprintf(stderr, "Message log is corrupt: Unable to write in new message.\n");
      }
+     
+     if (index != NULL)
+     {
+         fclose(index);
+     }
+     
+     fclose(msgLog);
       
      return 0;
  }
+ 
+ int writeAllVectors(int fd, struct iovec* iov, int iovCount)
+ {
+     while (iovCount > 0)
+     {
+         ssize_t written = writev(fd, iov, (iovCount < IOV_MAX) ? iovCount : IOV_MAX);
+         
+         if (written < 0)
+         {
+             if (errno == EINTR)
+             {
+                 continue;
+             }
+             
+             return 0;
+         }
+         
+         // Skip the buffers written, and the written part of the next one
+         while (iovCount > 0 && (size_t)written >= iov->iov_len)
+         {
+             written -= iov->iov_len;
+             iov++;
+             iovCount--;
+         }
+         
+         if (iovCount > 0)
+         {
+             iov->iov_base = (char*)iov->iov_base + written;
+             iov->iov_len -= written;
+         }
+     }
+     
+     return 1;
+ }
+
 
  void addNewLineIfNone(FILE* fp)
  {
@@ -283,3 +971,275 @@
         }
     }
  }
+ 
+ int statMsgLog(FILE* msgLog, long long* logSize, long long* logMtime)
+ {
+     struct stat logStat;
+     
+     // The size must include anything still buffered
+     fflush(msgLog);
+     
+     if (fstat(fileno(msgLog), &logStat) != 0)
+     {
+         return 0;
+     }
+     
+     *logSize = logStat.st_size;
+     *logMtime = logStat.st_mtim.tv_sec * 1000000000LL + logStat.st_mtim.tv_nsec;
+     
+     return 1;
+ }
+ 
+ FILE* loadMsgIndex(FILE* msgLog, MsgIndexHeader_t* header)
+ {
+     FILE *index = fopen(MSG_INDEX, "r+b");
+     long long logSize, logMtime;
+     
+     if (index != NULL && statMsgLog(msgLog, &logSize, &logMtime))
+     {
+         // The index is current if it was written for this very log
+         if (fread(header, sizeof(*header), 1, index) == 1 &&
+             header->magic == MSG_INDEX_MAGIC &&
+             header->logSize == logSize &&
+             header->logMtime == logMtime)
+         {
+             return index;
+         }
+     }
+     
+     if (index != NULL)
+     {
+         fclose(index);
+     }
+     
+     return rebuildMsgIndex(msgLog, header);
+ }
+ 
+ FILE* rebuildMsgIndex(FILE* msgLog, MsgIndexHeader_t* header)
+ {
+     const char *log;
+     size_t logLength;
+     MsgIndexEntry_t entry;
+     MsgSpan_t body;
+     size_t pos = 0;
+     int msgID, result;
+     
+     if (!statMsgLog(msgLog, &header->logSize, &header->logMtime) || !mapMsgLog(&log, &logLength) ||
+         (long long)logLength != header->logSize)
+     {
+         return NULL;
+     }
+     
+     // A file of its own, so peers rebuilding at the same time cannot mix their entries
+     char tempName[] = MSG_INDEX".XXXXXX";
+     int tempFd = mkstemp(tempName);
+     FILE *index = (tempFd != -1) ? fdopen(tempFd, "w+b") : NULL;
+     
+     if (index == NULL)
+     {
+         if (tempFd != -1)
+         {
+             close(tempFd);
+             remove(tempName);
+         }
+         return NULL;
+     }
+     
+     // mkstemp creates the file for its owner only
+     fchmod(tempFd, 0644);
+     
+     header->magic = MSG_INDEX_MAGIC;
+     header->count = 0;
+     
+     // Reserve room for the header, which is written last
+     fwrite(header, sizeof(*header), 1, index);
+     
+     while ((result = nextMappedMessage(log, logLength, &pos, &msgID, &body)) == 1)
+     {
+         // Only the next message in sequence may follow
+         if (msgID != FIRST_MESSAGE_INDEX + header->count)
+         {
+             break;
+         }
+         
+         entry.offset = body.start - log;
+         entry.length = body.length;
+         fwrite(&entry, sizeof(entry), 1, index);
+         header->count++;
+     }
+     
+     // Give up on logs the index cannot describe (out of sequence, unclosed)
+     if (result != 0)
+     {
+         fclose(index);
+         remove(tempName);
+         return NULL;
+     }
+     
+     rewind(index);
+     fwrite(header, sizeof(*header), 1, index);
+     fflush(index);
+     
+     if (rename(tempName, MSG_INDEX) != 0)
+     {
+         fclose(index);
+         remove(tempName);
+         return NULL;
+     }
+     
+     return index;
+ }
+ 
+ int readMsgIndexEntry(FILE* index, const MsgIndexHeader_t* header, int msgID, MsgIndexEntry_t* entry)
+ {
+     if (msgID < FIRST_MESSAGE_INDEX || msgID >= FIRST_MESSAGE_INDEX + header->count)
+     {
+         return 0;
+     }
+     
+     // Entries have a fixed size, so message msgID is found with one seek
+     fseek(index, sizeof(*header) + (long)sizeof(*entry)*(msgID - FIRST_MESSAGE_INDEX), SEEK_SET);
+     
+     return fread(entry, sizeof(*entry), 1, index) == 1;
+ }
+ 
+ int mapMsgLog(const char** log, size_t* length)
+ {
+     struct stat pathStat, logStat;
+     
+     if (stat(MSG_LOG, &pathStat) != 0)
+     {
+         return 0;
+     }
+     
+     // Reopen the log if it has been replaced by another file
+     if (msgLogMap.fd != -1 &&
+         (pathStat.st_dev != msgLogMap.device || pathStat.st_ino != msgLogMap.inode))
+     {
+         if (msgLogMap.base != NULL)
+         {
+             munmap(msgLogMap.base, msgLogMap.length);
+         }
+         
+         close(msgLogMap.fd);
+         msgLogMap.fd = -1;
+         msgLogMap.base = NULL;
+         msgLogMap.length = 0;
+     }
+     
+     if (msgLogMap.fd == -1)
+     {
+         msgLogMap.fd = open(MSG_LOG, O_RDONLY | O_CLOEXEC);
+         
+         if (msgLogMap.fd == -1)
+         {
+             return 0;
+         }
+     }
+     
+     if (fstat(msgLogMap.fd, &logStat) != 0)
+     {
+         return 0;
+     }
+     
+     msgLogMap.device = logStat.st_dev;
+     msgLogMap.inode = logStat.st_ino;
+     
+     // Remap only when the size has changed
+     if ((size_t)logStat.st_size != msgLogMap.length || (msgLogMap.base == NULL && logStat.st_size > 0))
+     {
+         if (msgLogMap.base != NULL)
+         {
+             munmap(msgLogMap.base, msgLogMap.length);
+             msgLogMap.base = NULL;
+         }
+         
+         msgLogMap.length = logStat.st_size;
+         
+         // An empty file cannot be mapped, but it has no messages either
+         if (msgLogMap.length > 0)
+         {
+             void *base = mmap(NULL, msgLogMap.length, PROT_READ, MAP_SHARED, msgLogMap.fd, 0);
+             
+             if (base == MAP_FAILED)
+             {
+                 msgLogMap.length = 0;
+                 return 0;
+             }
+             
+             msgLogMap.base = base;
+         }
+     }
+     
+     *log = msgLogMap.base;
+     *length = msgLogMap.length;
+     
+     return 1;
+ }
+ 
+ int msgLogMapHolds(size_t end)
+ {
+     struct stat logStat;
+     
+     return msgLogMap.fd != -1 && end <= msgLogMap.length &&
+            fstat(msgLogMap.fd, &logStat) == 0 && (size_t)logStat.st_size >= end;
+ }
+ 
+ int nextMappedMessage(const char* log, size_t length, size_t* pos, int* msgID, MsgSpan_t* body)
+ {
+     const char *end = log + length;
+     const char *line = log + *pos;
+     const size_t tagLen = strlen(CLOSING_XML_TAG_FORMAT);
+     
+     while (line < end)
+     {
+         const char *newline = memchr(line, '\n', end - line);
+         const char *next = (newline != NULL) ? newline + 1 : end;
+         
+         // Only lines starting like an opening tag are parsed
+         if (*line == '<')
+         {
+             char tag[MAX_OPENING_TAG_LEN];
+             size_t lineLen = next - line;
+             
+             if (lineLen > sizeof(tag)-1)
+             {
+                 lineLen = sizeof(tag)-1;
+             }
+             
+             memcpy(tag, line, lineLen);
+             tag[lineLen] = '\0';
+             
+             if (sscanf(tag, OPENING_XML_TAG_FORMAT, msgID) == 1)
+             {
+                 const char *closing = memmem(next, end - next, CLOSING_XML_TAG_FORMAT, tagLen);
+                 
+                 body->start = next;
+                 
+                 if (closing == NULL)
+                 {
+                     body->length = end - next;
+                     *pos = length;
+                     return 2;
+                 }
+                 
+                 // The body ends where the closing tag line starts
+                 const char *closingLine = memrchr(next, '\n', closing - next);
+                 
+                 closingLine = (closingLine != NULL) ? closingLine + 1 : next;
+                 body->length = closingLine - next;
+                 
+                 // Continue after the closing tag line
+                 newline = memchr(closing, '\n', end - closing);
+                 *pos = (newline != NULL) ? (size_t)(newline + 1 - log) : length;
+                 
+                 return 1;
+             }
+         }
+         
+         line = next;
+     }
+     
+     *pos = length;
+     return 0;
+ }
@@ -35,6 +35,17 @@
  * The XML tags are case-sensitive. The tags should be used exactly as documented above.
  * If the format is not followed exactly, the message will be rejected. 
  *
+ * INDEX:
+ *      Next to the log, MSG_INDEX holds the byte offset and length of the body of every
+ *      message, so a message is found with one seek and the message count (the last
+ *      ID, used by both getMessageCount and appendMsg) is read from the index header.
+ *      The header records the size and modification time of the log it describes.
+ *      appendMsg keeps the index up to date; an index that is missing or no longer
+ *      matches the log is rebuilt with a single scan of the log. Logs that cannot be
+ *      indexed (messages out of sequence or unclosed) are scanned as before, but the
+ *      last ID found is remembered until the size or modification time of the log
+ *      changes.
+ *
  * @author Luke Kledzik
  * @author Adam Mooers
  * @date 2/13/2017
@@ -45,17 +56,37 @@
 #define MSGPARSER_H
 
 #include <stdio.h>
+#include <stddef.h>
  
 #define MSG_LOG "messages.txt" 
+#define MSG_INDEX MSG_LOG".idx"
 #define FIRST_MESSAGE_INDEX 1
 
 #define OPENING_XML_TAG_FORMAT "<message n=%d>"
 #define CLOSING_XML_TAG_FORMAT "</message>"
+
+// Methods of scanMessageLog
+#define SCAN_STDIO 0
+#define SCAN_MMAP 1
+
+ /**
+  * A message body inside the memory-mapped message log. The bytes are not copied
+  * and not null-terminated. A span stays valid until the next call into msgparser
+  * that finds the log changed (e.g. after an append).
+  */
+ struct MSG_SPAN
+ {
+     const char *start;      /* first byte of the body */
+     size_t length;          /* bytes in the body */
+ };
+ 
+ typedef struct MSG_SPAN MsgSpan_t;
  
  /**
-  * Retrieves a message from the database by its ID. This is accomplished by
-  * scanning the messages in the database in a linear manner, starting with the
-  * first. The message body is printed to the given IO stream (such as the terminal).
+  * Retrieves a message from the database by its ID. The message is looked up in
+  * the index (see INDEX above) and printed straight from the memory-mapped log.
+  * Only if the log cannot be indexed are the messages scanned in a linear manner,
+  * starting with the first. The message body is printed to the given IO stream (such as the terminal).
   * Error codes are printed to stderr.
   *
   *	USAGE:
@@ -69,6 +100,53 @@
  
  int readMessageByID(int match, FILE *outputStream);
  
+ /**
+  * Finds the body of a message in the memory-mapped log without copying it.
+  * The log is mapped on first use and remapped only when it has changed size.
+  *
+  * @param msgID the ID of the message to find
+  * @param span where to store the body
+  * @return 1 if found, 0 if there is no such message, -1 if the log cannot be mapped
+  */
+ 
+ int findMessageSpan(int msgID, MsgSpan_t *span);
+ 
+ /**
+  * Streams the messages first to last to a file descriptor in one sequential
+  * pass, in the format of the log itself (tags included), so the output can be
+  * read back as a message log. The ends of the range are looked up in the index,
+  * and the part of the log between them is sent with sendfile. A range reaching
+  * past the last message ends with the last message. For logs that cannot be
+  * indexed, the part of the log from the first to the last message in the range
+  * is sent. Any stream writing to fd should be flushed first.
+  *
+  *	USAGE:
+  *		// Print messages 3 to 7 to the terminal
+  *		fflush(stdout);
+  *		exportMessages(3, 7, STDOUT_FILENO);
+  *
+  * @param first the ID of the first message to export
+  * @param last the ID of the last message to export
+  * @param fd the file descriptor to write to (a terminal, file, pipe or socket)
+  * @return the number of messages exported, or -1 if unsuccessful
+  */
+ 
+ int exportMessages(int first, int last, int fd);
+ 
+ /**
+  * Scans the whole log for the ID of the last message, without using the index.
+  * SCAN_STDIO reads the log with stdio a line at a time, SCAN_MMAP looks for line
+  * and message boundaries in the mapped log with memchr. Both follow the rules of
+  * nextMappedMessage (an opening tag inside a message body is part of the body),
+  * so they give the same result; the choice only affects speed.
+  *
+  * @param method SCAN_STDIO or SCAN_MMAP
+  * @return the ID of the last message, or FIRST_MESSAGE_INDEX-1 if there are none
+  *         or the log cannot be read
+  */
+ 
+ int scanMessageLog(int method);
+ 
  /**
   * Returns the ID of the most recent (last) message posted to the the <MSG_LOG> 
   * database file. This is also the number of messages in the file. Error codes are printed
@@ -94,4 +172,19 @@
   
  int appendMsg(const char *msg);
  
+ /**
+  * Appends several messages to the end of the <MSG_LOG> log file as one group
+  * commit: all of them are written with a single writev and made durable with a
+  * single fsync. The messages are given consecutive IDs in the order given.
+  * A failed write is taken back, so that either all of the messages are in the
+  * log or none is; a failed fsync is only reported, as the messages are in the
+  * log by then. Error codes are printed to stderr.
+  * 
+  * @param msgs the null-terminated strings containing the messages to append
+  * @param count the number of messages
+  * @return the number of messages appended (count if they were written, 0 otherwise)
+  */
+  
+ int appendMsgs(const char **msgs, int count);
+ 
  #endif
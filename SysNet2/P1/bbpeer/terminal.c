@@ -13,7 +13,9 @@
  #include <ctype.h>
  #include <string.h>
  #include <stdlib.h>
+ #include <unistd.h>
  #include "msgparser.h"
+ #include "msgbinlog.h"
  #include "terminal.h"
 
  // Delimiters for tokenizing user commands
@@ -50,12 +52,33 @@
  // the terminal thread has a lock on terminalLock.
  enum commandCode tempUserCmd = NONE;
 
- // The message id to read when the command code is READ
+ // The message ids to read (first to last) when the command code is READ
  int msgIdToRead;
+ int msgIdToReadLast;
 
  // Reference to the terminal thread singleton
  pthread_t terminalThread;
 
+ // See terminal.h
+ pthread_mutex_t terminalLock;
+
+ // Messages written by the user that wait for the token. They are committed
+ // together by flushPendingWrites. The queue has its own lock so the user can
+ // keep writing while the network thread holds terminalLock.
+ char** pendingWrites = NULL;
+ int pendingWriteCount = 0;
+ int pendingWriteCapacity = 0;
+ pthread_mutex_t pendingWritesLock;
+
+/**
+ * Adds a copy of a message to the queue of pending writes.
+ *
+ * @param msg the null-terminated message
+ * @return 1 if successful, 0 if out of memory
+ */
+
+ int queuePendingWrite(const char* msg);
+
  /*int main()
  {
 	runTerminalThread();
@@ -87,6 +110,21 @@
 		// Parse the command from the user
 		parseCmdString(msgTempBuffer);
 
+		// Writes are queued instead of waiting for the token one at a time
+		if (tempUserCmd == WRITE)
+		{
+			if (queuePendingWrite(msgTempBuffer))
+			{
+				printf("Message queued. It will be posted when the token arrives.\n");
+			}
+			else
+			{
+				printf("Out of memory: The message was not queued.\n");
+			}
+
+			continue;
+		}
+
 		printf("Entering Lock in Terminal thread\n");
 		
 		// Wait for the token to come to the network thread
@@ -161,20 +199,30 @@
 	 {
 		 if (numInputArgs == 2)
 		 {
+			 int first, last, rangeLen;
+
 			 // Check if the argument is valid
 			 if (isInt(tokenArr[1]))
 			 {
 				tempUserCmd = READ;
 				msgIdToRead = atoi(tokenArr[1]);
+				msgIdToReadLast = msgIdToRead;
+			 }
+			 else if (sscanf(tokenArr[1], "%d-%d%n", &first, &last, &rangeLen) == 2 &&
+			          tokenArr[1][rangeLen] == '\0' && first <= last)
+			 {
+				tempUserCmd = READ;
+				msgIdToRead = first;
+				msgIdToReadLast = last;
 			 }
 			 else
 			 {
-				printf("The message id must be an integer.\n");
+				printf("The message id must be an integer or a range <first>-<last>.\n");
 			 }
 		 }
 		 else
 		 {
-			 printf(ERR_WRONG_NUM_ARGUMENTS"read <message id>\n");
+			 printf(ERR_WRONG_NUM_ARGUMENTS"read <message id>|<first>-<last>\n");
 		 }
 	 }
 	 else if (strcmp(tokenArr[0], "list") == 0)
@@ -236,8 +284,9 @@
 		 // Update the current message length
 		 curMessageLen = strlen(msgTempBuffer);
 
-		 // Don't let user put closing tags into the message
-		 if (strstr(lastLineStart, CLOSING_XML_TAG_FORMAT) != NULL)
+		 // Don't let user put closing tags into the message (the binary
+		 // log has no tags, so any text is allowed there)
+		 if (!BINARY_LOG && strstr(lastLineStart, CLOSING_XML_TAG_FORMAT) != NULL)
 		 {
 			 fprintf(stdout, "\nThe closing tag "CLOSING_XML_TAG_FORMAT" cannot be contained within the message body.\n");
 			 fprintf(stdout, "Please correct the line:\n\n");
@@ -277,6 +326,7 @@
  {
 	// Set up the terminal thread
 	pthread_mutex_init(&terminalLock, NULL);
+	pthread_mutex_init(&pendingWritesLock, NULL);
 
 	// Create a new terminal thread
 	//(void *)&argN is the pattern for inputs
@@ -295,18 +345,37 @@
 
  void handleCommandsWithToken()
  {
-	 int msgCount;
+	 int msgCount, msgId;
+
+	 // Post queued messages first, so reads and lists include them
+	 flushPendingWrites();
 
 	 switch (userCmd)
 	 {
-		 case WRITE:
-			appendMsg(msgTempBuffer);
-			break;
 		 case READ:
-			readMessageByID(msgIdToRead, stdout);
+			if (msgIdToReadLast == msgIdToRead)
+			{
+				if (BINARY_LOG) readBinMessageByID(msgIdToRead, stdout);
+				else readMessageByID(msgIdToRead, stdout);
+			}
+			else if (BINARY_LOG)
+			{
+				msgCount = getBinMessageCount();
+
+				for (msgId = msgIdToRead; msgId <= msgIdToReadLast && msgId <= msgCount; msgId++)
+				{
+					readBinMessageByID(msgId, stdout);
+				}
+			}
+			else
+			{
+				// Stream the range straight from the log to the terminal
+				fflush(stdout);
+				exportMessages(msgIdToRead, msgIdToReadLast, STDOUT_FILENO);
+			}
 			break;
 		 case LIST:
-			msgCount = getMessageCount();
+			msgCount = BINARY_LOG ? getBinMessageCount() : getMessageCount();
 			if (msgCount != FIRST_MESSAGE_INDEX-1)
 			{
 				printf("Valid Message Range: %d - %d\n", FIRST_MESSAGE_INDEX, msgCount);
@@ -317,6 +386,119 @@
 	 }
  }
 
+ int queuePendingWrite(const char* msg)
+ {
+	 char* copy = strdup(msg);
+
+	 if (copy == NULL)
+	 {
+		 return 0;
+	 }
+
+	 pthread_mutex_lock(&pendingWritesLock);
+
+	 if (pendingWriteCount == pendingWriteCapacity)
+	 {
+		 int capacity = (pendingWriteCapacity > 0) ? pendingWriteCapacity * 2 : 16;
+		 char** writes = realloc(pendingWrites, sizeof(*writes) * capacity);
+
+		 if (writes == NULL)
+		 {
+			 pthread_mutex_unlock(&pendingWritesLock);
+			 free(copy);
+			 return 0;
+		 }
+
+		 pendingWrites = writes;
+		 pendingWriteCapacity = capacity;
+	 }
+
+	 pendingWrites[pendingWriteCount++] = copy;
+
+	 pthread_mutex_unlock(&pendingWritesLock);
+
+	 return 1;
+ }
+
+ void flushPendingWrites()
+ {
+	 int i;
+
+	 // Take the whole queue, so the user can queue more during the commit
+	 pthread_mutex_lock(&pendingWritesLock);
+
+	 char** writes = pendingWrites;
+	 int count = pendingWriteCount;
+
+	 pendingWrites = NULL;
+	 pendingWriteCount = 0;
+	 pendingWriteCapacity = 0;
+
+	 pthread_mutex_unlock(&pendingWritesLock);
+
+	 if (count == 0)
+	 {
+		 free(writes);
+		 return;
+	 }
+
+	 // One group commit for everything queued since the last token
+	 int appended = BINARY_LOG ? appendBinMsgs((const char**)writes, count)
+	                           : appendMsgs((const char**)writes, count);
+
+	 for (i = 0; i < appended; i++)
+	 {
+		 free(writes[i]);
+	 }
+
+	 if (appended == count)
+	 {
+		 free(writes);
+		 return;
+	 }
+
+	 // Put the messages that were not posted back in front of the ones queued
+	 // meanwhile, so they go out first (and in order) with the next token
+	 int unposted = count - appended;
+
+	 pthread_mutex_lock(&pendingWritesLock);
+
+	 char** requeued = realloc(writes, sizeof(*requeued) * (unposted + pendingWriteCount));
+
+	 if (requeued != NULL)
+	 {
+		 memmove(requeued, requeued + appended, sizeof(*requeued) * unposted);
+
+		 if (pendingWriteCount > 0)
+		 {
+			 memcpy(requeued + unposted, pendingWrites, sizeof(*requeued) * pendingWriteCount);
+		 }
+
+		 free(pendingWrites);
+		 pendingWrites = requeued;
+		 pendingWriteCount += unposted;
+		 pendingWriteCapacity = pendingWriteCount;
+	 }
+
+	 pthread_mutex_unlock(&pendingWritesLock);
+
+	 if (requeued != NULL)
+	 {
+		 printf("\n%d queued message(s) could not be posted. They will be retried with the next token.\n", unposted);
+	 }
+	 else
+	 {
+		 printf("\n%d queued message(s) could not be posted and were lost.\n", unposted);
+
+		 for (i = appended; i < count; i++)
+		 {
+			 free(writes[i]);
+		 }
+
+		 free(writes);
+	 }
+ }
+
  int isInt(const char* str) {
     // Account for sign
     if (*str == '+' || *str == '-') str++;
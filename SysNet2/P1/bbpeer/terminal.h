@@ -6,15 +6,18 @@
  * The following commands are supported:
  *
  * ACTION:				DESCRIPTION:
- * write				Appends a new message to the end of the message board.
+ * write				Queues a new message to be appended to the end of the message board.
  * read <message id>	Reads the message <message id> from the message board to stdout
+ * read <first>-<last>	Reads the messages <first> to <last> (with their tags) to stdout
  * list 				Displays the range of valid sequence
  * exit					Close the message board
  *
  * To initiate each of the above actions, the user must have the token to lock the message 
  * log. Because the user operates at a different rate than the token ring messages, the terminal
  * launches in its own independent thread. The proper command handler is stored as a function
- * for the token thread to handle in its own time.
+ * for the token thread to handle in its own time. Written messages do not wait for the token
+ * one at a time: they are queued, and everything queued is posted in one group commit the
+ * next time the token is held.
  *
  * @author Luke Kledzik
  * @author Adam Mooers
@@ -28,8 +31,8 @@
  #include <pthread.h>
  
  // Mutex lock used whenever the terminal is updating information for the 
- // token ring. A global lock is used for simplicity.
- pthread_mutex_t terminalLock;
+ // token ring. A global lock is used for simplicity. It is defined in terminal.c.
+ extern pthread_mutex_t terminalLock;
  
  // Code to end a multi-line message when placed on a new line and followed
  // immediately by another new line.
@@ -90,6 +93,16 @@
   
  void handleCommandsWithToken();
  
+ /**
+  * Posts every queued message to the message log in one group commit (see
+  * appendMsgs). This must only be called while the token is held, i.e. with a
+  * lock on terminalLock. Messages queued during the commit wait for the next one.
+  * Messages that could not be posted go back to the front of the queue and are
+  * retried with the next token.
+  */
+  
+ void flushPendingWrites();
+ 
  /**
   * Determines if a given string can be converted to a valid integer.
   * The integer may start with a plus or minus sign. The length of the
@@ -105,4 +118,4 @@
   */
  int exitPending();
 
-#endif
\ No newline at end of file
+#endif